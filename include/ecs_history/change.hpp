@@ -6,21 +6,41 @@
 #define ECS_HISTORY_CHANGE_H
 
 #include "static_entity.hpp"
+#include "memory.hpp"
+#include "checksum.hpp"
+#include "payload.hpp"
+#include "serialization/codec.hpp"
 #include <cereal/archives/portable_binary.hpp>
 
 namespace ecs_history {
 template<typename T>
 class change_supplier_t;
 
+enum class change_type_t : uint8_t {
+    CONSTRUCT = 0,
+    UPDATE = 1,
+    UPDATE_ONLY_NEW = 2,
+    DESTRUCT = 3,
+    DESTRUCT_ONLY_NEW = 4
+};
+
 template<typename T>
 struct change_t {
     const static_entity_t static_entity;
+    /**
+     * CONSTRUCT, UPDATE or DESTRUCT, so callers knowing T can dispatch without virtual calls.
+     */
+    const change_type_t type;
 
-    explicit change_t(const static_entity_t static_entity) : static_entity(static_entity) {
+    explicit change_t(const static_entity_t static_entity, const change_type_t type)
+        : static_entity(static_entity), type(type) {
     }
 
+    /**
+     * Returns the heap memory used by this change, including its own allocation.
+     */
     [[nodiscard]] virtual size_t size() const {
-        return sizeof(static_entity_t);
+        return memory::heap_block(sizeof(*this));
     }
 
     [[nodiscard]] virtual std::unique_ptr<change_t> invert() const = 0;
@@ -35,14 +55,14 @@ struct destruct_change_t;
 
 template<typename T>
 struct construct_change_t final : change_t<T> {
-    const T value;
+    const payload_t<T> value;
 
-    explicit construct_change_t(const static_entity_t static_entity, T value)
-        : change_t<T>(static_entity), value(value) {
+    explicit construct_change_t(const static_entity_t static_entity, payload_t<T> value)
+        : change_t<T>(static_entity, change_type_t::CONSTRUCT), value(std::move(value)) {
     }
 
     [[nodiscard]] size_t size() const override {
-        return sizeof(T) + change_t<T>::size();
+        return memory::heap_block(sizeof(*this)) + value.heap_usage();
     }
 
     [[nodiscard]] std::unique_ptr<change_t<T> > invert() const override {
@@ -56,15 +76,22 @@ struct construct_change_t final : change_t<T> {
 
 template<typename T>
 struct update_change_t final : change_t<T> {
-    const T old_value;
-    const T new_value;
-
-    explicit update_change_t(const static_entity_t static_entity, T old_value, T new_value)
-        : change_t<T>(static_entity), old_value(old_value), new_value(new_value) {
+    /**
+     * Not sent over the network. change_applier_t fills it with the local value when applying.
+     */
+    mutable payload_t<T> old_value;
+    const payload_t<T> new_value;
+
+    explicit update_change_t(const static_entity_t static_entity,
+                             payload_t<T> old_value,
+                             payload_t<T> new_value)
+        : change_t<T>(static_entity, change_type_t::UPDATE),
+          old_value(std::move(old_value)),
+          new_value(std::move(new_value)) {
     }
 
     [[nodiscard]] size_t size() const override {
-        return 2 * sizeof(T) + change_t<T>::size();
+        return memory::heap_block(sizeof(*this)) + old_value.heap_usage() + new_value.heap_usage();
     }
 
     [[nodiscard]] std::unique_ptr<change_t<T> > invert() const override {
@@ -78,14 +105,17 @@ struct update_change_t final : change_t<T> {
 
 template<typename T>
 struct destruct_change_t final : change_t<T> {
-    const T old_value;
+    /**
+     * Not sent over the network. change_applier_t fills it with the local value when applying.
+     */
+    mutable payload_t<T> old_value;
 
-    explicit destruct_change_t(const static_entity_t static_entity, T old_value)
-        : change_t<T>(static_entity), old_value(old_value) {
+    explicit destruct_change_t(const static_entity_t static_entity, payload_t<T> old_value)
+        : change_t<T>(static_entity, change_type_t::DESTRUCT), old_value(std::move(old_value)) {
     }
 
     [[nodiscard]] size_t size() const override {
-        return sizeof(T) + change_t<T>::size();
+        return memory::heap_block(sizeof(*this)) + old_value.heap_usage();
     }
 
     [[nodiscard]] std::unique_ptr<change_t<T> > invert() const override {
@@ -110,14 +140,6 @@ public:
 };
 
 
-enum class change_type_t : uint8_t {
-    CONSTRUCT = 0,
-    UPDATE = 1,
-    UPDATE_ONLY_NEW = 2,
-    DESTRUCT = 3,
-    DESTRUCT_ONLY_NEW = 4
-};
-
 template<typename T>
 class change_applier_t final : public change_supplier_t<T> {
     entt::storage<T> &storage;
@@ -131,47 +153,109 @@ public:
 
     void apply(const construct_change_t<T> &c) override {
         const auto entt = this->static_entities.increase_ref(c.static_entity);
-        this->storage.emplace(entt, c.value);
+        this->storage.emplace(entt, c.value.get());
+        track_checksum<T>(this->static_entities,
+                          this->storage.info().hash(),
+                          c.static_entity,
+                          nullptr,
+                          &c.value.get());
     }
 
     void apply(const update_change_t<T> &c) override {
         const auto entt = this->static_entities.get_entity(c.static_entity);
+        // Keep the pre-image, received changes do not carry it
         this->storage.patch(entt,
-                            [c](T &v) {
-                                v = c.new_value;
+                            [&c](T &v) {
+                                // v is overwritten anyway, so its old contents can be moved
+                                c.old_value = payload_t<T>(std::move(v));
+                                v = c.new_value.get();
                             });
+        track_checksum(this->static_entities,
+                       this->storage.info().hash(),
+                       c.static_entity,
+                       &c.old_value.get(),
+                       &c.new_value.get());
     }
 
     void apply(const destruct_change_t<T> &c) override {
         const auto entt = this->static_entities.get_entity(c.static_entity);
+        if constexpr (entt::component_traits<T>::page_size != 0u) {
+            c.old_value = this->storage.get(entt);
+        }
         this->storage.remove(entt);
+        track_checksum<T>(this->static_entities,
+                          this->storage.info().hash(),
+                          c.static_entity,
+                          &c.old_value.get(),
+                          nullptr);
         this->static_entities.decrease_ref(c.static_entity);
     }
 };
 
+/**
+ * Updates the checksum of a storage for changes that were recorded but not applied by change_applier_t.
+ */
+template<typename T>
+class checksum_tracker_t final : public change_supplier_t<T> {
+    static_entities_t &static_entities;
+    const entt::id_type id;
+
+public:
+    checksum_tracker_t(static_entities_t &static_entities, const entt::id_type id)
+        : static_entities(static_entities), id(id) {
+    }
+
+    void apply(const construct_change_t<T> &c) override {
+        track_checksum<T>(this->static_entities, this->id, c.static_entity, nullptr, &c.value.get());
+    }
+
+    void apply(const update_change_t<T> &c) override {
+        track_checksum(this->static_entities,
+                       this->id,
+                       c.static_entity,
+                       &c.old_value.get(),
+                       &c.new_value.get());
+    }
+
+    void apply(const destruct_change_t<T> &c) override {
+        track_checksum<T>(this->static_entities, this->id, c.static_entity, &c.old_value.get(), nullptr);
+    }
+};
+
 template<typename T>
 class change_serializer_t final : public change_supplier_t<T> {
     cereal::PortableBinaryOutputArchive &archive;
+    const bool with_entity;
+
+    void write_entity(const static_entity_t static_entity) {
+        if (with_entity) {
+            archive(static_entity);
+        }
+    }
 
 public:
-    explicit change_serializer_t(cereal::PortableBinaryOutputArchive &archive)
-        : archive(archive) {
+    /**
+     * @param with_entity false writes only the change body, for protocols that encode entities themselves
+     */
+    explicit change_serializer_t(cereal::PortableBinaryOutputArchive &archive,
+                                 const bool with_entity = true)
+        : archive(archive), with_entity(with_entity) {
     }
 
     void apply(const construct_change_t<T> &c) override {
-        archive(c.static_entity);
+        write_entity(c.static_entity);
         archive(change_type_t::CONSTRUCT);
-        archive(c.value);
+        codec::save(archive, c.value.get());
     }
 
     void apply(const update_change_t<T> &c) override {
-        archive(c.static_entity);
+        write_entity(c.static_entity);
         archive(change_type_t::UPDATE_ONLY_NEW);
-        archive(c.new_value);
+        codec::save(archive, c.new_value.get());
     }
 
     void apply(const destruct_change_t<T> &c) override {
-        archive(c.static_entity);
+        write_entity(c.static_entity);
         archive(change_type_t::DESTRUCT_ONLY_NEW);
     }
 };
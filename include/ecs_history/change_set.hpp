@@ -5,11 +5,20 @@
 #ifndef ECS_HISTORY_CHANGE_SET_HPP
 #define ECS_HISTORY_CHANGE_SET_HPP
 
+#include <span>
+#include <unordered_set>
 #include <entt/entt.hpp>
 #include "change.hpp"
+#include "update_filter.hpp"
+#include "tracing.hpp"
 
 namespace ecs_history {
 
+/**
+ * Reads the entity of the next change when it is not stored next to the change.
+ */
+using entity_reader_t = std::function<static_entity_t()>;
+
 class base_change_set_t {
 public:
     entt::id_type id;
@@ -22,14 +31,58 @@ public:
 
     virtual void apply(entt::registry &reg, static_entities_t &entities) const = 0;
 
+    /**
+     * Applies the changes in [begin, end).
+     */
+    virtual void apply_range(entt::registry &reg,
+                             static_entities_t &entities,
+                             size_t begin,
+                             size_t end) const = 0;
+
     virtual void serialize(cereal::PortableBinaryOutputArchive &archive) const = 0;
 
-    [[nodiscard]]
+    [[nodiscard]] virtual static_entity_t entity_at(size_t index) const = 0;
+
+    [[nodiscard]] virtual bool is_destruct(size_t index) const = 0;
 
-    virtual size_t size() const = 0;
+    /**
+     * Serializes a single change in the same format as serialize.
+     */
+    virtual void serialize_change(size_t index,
+                                  cereal::PortableBinaryOutputArchive &archive) const = 0;
+
+    /**
+     * Serializes a single change without its entity.
+     */
+    virtual void serialize_change_body(size_t index,
+                                       cereal::PortableBinaryOutputArchive &archive) const = 0;
+
+    /**
+     * Returns the heap memory used by this change set, including its own allocation.
+     */
+    [[nodiscard]] virtual size_t size() const = 0;
 
     [[nodiscard]] virtual size_t count() const = 0;
 
+    /**
+     * Removes updates that do not change the value, see drop_noop_updates_t.
+     * Returns the number of removed changes.
+     */
+    virtual size_t drop_noop_updates() = 0;
+
+    /**
+     * Returns the net changes of the given change sets, applied in order: one change per entity,
+     * destructs last. The change sets have to be of the component of this one.
+     */
+    [[nodiscard]] virtual std::unique_ptr<base_change_set_t> coalesce(
+        std::span<const base_change_set_t *const> change_sets) const = 0;
+
+    /**
+     * Called on the result of coalesce after applying it. Fills the pre-images of the changes
+     * in the coalesced change sets, as applying each of them would have.
+     */
+    virtual void fill_pre_images(std::span<const base_change_set_t *const> change_sets) const = 0;
+
     virtual ~base_change_set_t() = default;
 };
 
@@ -37,6 +90,60 @@ template<typename T>
 class change_set_t final : public base_change_set_t {
     std::vector<std::unique_ptr<change_t<T> > > changes;
 
+    static const payload_t<T> *pre_image(const change_t<T> &change) {
+        switch (change.type) {
+            case change_type_t::CONSTRUCT:
+                return nullptr;
+            case change_type_t::UPDATE:
+                return &static_cast<const update_change_t<T> &>(change).old_value;
+            default:
+                return &static_cast<const destruct_change_t<T> &>(change).old_value;
+        }
+    }
+
+    static const payload_t<T> *post_image(const change_t<T> &change) {
+        switch (change.type) {
+            case change_type_t::CONSTRUCT:
+                return &static_cast<const construct_change_t<T> &>(change).value;
+            case change_type_t::UPDATE:
+                return &static_cast<const update_change_t<T> &>(change).new_value;
+            default:
+                return nullptr;
+        }
+    }
+
+    /**
+     * Calls the overload of the concrete change directly. Supplier has to be final,
+     * so neither the change nor the supplier is called virtually.
+     */
+    template<typename Supplier>
+    static void visit(const change_t<T> &change, Supplier &supplier) {
+        switch (change.type) {
+            case change_type_t::CONSTRUCT:
+                supplier.apply(static_cast<const construct_change_t<T> &>(change));
+                break;
+            case change_type_t::UPDATE:
+                supplier.apply(static_cast<const update_change_t<T> &>(change));
+                break;
+            default:
+                supplier.apply(static_cast<const destruct_change_t<T> &>(change));
+                break;
+        }
+    }
+
+    static void set_pre_image(const change_t<T> &change, const payload_t<T> &value) {
+        switch (change.type) {
+            case change_type_t::CONSTRUCT:
+                break;
+            case change_type_t::UPDATE:
+                static_cast<const update_change_t<T> &>(change).old_value = value;
+                break;
+            default:
+                static_cast<const destruct_change_t<T> &>(change).old_value = value;
+                break;
+        }
+    }
+
 public:
     explicit change_set_t(const entt::id_type id = entt::type_hash<T>::value())
         : base_change_set_t(id) {
@@ -48,7 +155,7 @@ public:
     }
 
     [[nodiscard]] size_t size() const override {
-        size_t size = 0;
+        size_t size = memory::heap_block(sizeof(*this)) + memory::vector_bytes(this->changes);
         for (const auto &change : this->changes) {
             size += change->size();
         }
@@ -65,6 +172,10 @@ public:
         return std::move(new_commit);
     }
 
+    [[nodiscard]] const change_t<T> &at(const size_t index) const {
+        return *this->changes[index];
+    }
+
     void add_change(std::unique_ptr<change_t<T> > change) {
         this->changes.emplace_back(std::move(change));
     }
@@ -80,19 +191,126 @@ public:
         return this->changes.size();
     }
 
+    size_t drop_noop_updates() override {
+        if constexpr (drop_noop_updates_v<T>) {
+            return std::erase_if(this->changes,
+                                 [](const std::unique_ptr<change_t<T> > &change) {
+                                     if (change->type != change_type_t::UPDATE) {
+                                         return false;
+                                     }
+                                     const auto &update = static_cast<const update_change_t<T> &>(*change);
+                                     return is_noop_update(update.old_value.get(), update.new_value.get());
+                                 });
+        } else {
+            return 0;
+        }
+    }
+
+    [[nodiscard]] std::unique_ptr<base_change_set_t> coalesce(
+        const std::span<const base_change_set_t *const> change_sets) const override {
+        // First and last change of every entity, in the order entities first appear
+        std::unordered_map<static_entity_t, size_t> chain_of;
+        std::vector<std::pair<const change_t<T> *, const change_t<T> *> > chains;
+        for (const auto *change_set : change_sets) {
+            for (const auto &change : static_cast<const change_set_t &>(*change_set).changes) {
+                const auto [it, inserted] = chain_of.try_emplace(change->static_entity, chains.size());
+                if (inserted) {
+                    chains.emplace_back(change.get(), change.get());
+                } else {
+                    chains[it->second].second = change.get();
+                }
+            }
+        }
+        auto coalesced = std::make_unique<change_set_t>(this->id);
+        std::vector<std::unique_ptr<change_t<T> > > destructs;
+        for (const auto &[first, last] : chains) {
+            const auto *before = pre_image(*first);
+            const auto *after = post_image(*last);
+            if (before == nullptr && after != nullptr) {
+                coalesced->add_change(std::make_unique<construct_change_t<T> >(first->static_entity, *after));
+            } else if (before != nullptr && after != nullptr) {
+                coalesced->add_change(
+                    std::make_unique<update_change_t<T> >(first->static_entity, *before, *after));
+            } else if (before != nullptr) {
+                destructs.push_back(std::make_unique<destruct_change_t<T> >(first->static_entity, *before));
+            }
+            // Constructed and destructed again: nothing left to apply
+        }
+        // Destructs go last so no entity runs out of references while it gains others
+        for (auto &destruct : destructs) {
+            coalesced->add_change(std::move(destruct));
+        }
+        return coalesced;
+    }
+
+    void fill_pre_images(const std::span<const base_change_set_t *const> change_sets) const override {
+        std::unordered_map<static_entity_t, const change_t<T> *> previous;
+        for (const auto &change : this->changes) {
+            previous.emplace(change->static_entity, change.get());
+        }
+        // The applied net change holds the value before the first change of its entity,
+        // every later change starts from the value its predecessor left
+        std::unordered_set<static_entity_t> seen;
+        for (const auto *change_set : change_sets) {
+            for (const auto &change : static_cast<const change_set_t &>(*change_set).changes) {
+                const bool first = seen.insert(change->static_entity).second;
+                const auto it = previous.find(change->static_entity);
+                if (it != previous.end()) {
+                    const auto *before = first ? pre_image(*it->second) : post_image(*it->second);
+                    if (before != nullptr) {
+                        set_pre_image(*change, *before);
+                    }
+                }
+                previous[change->static_entity] = change.get();
+            }
+        }
+    }
+
     void apply(entt::registry &reg, static_entities_t &entities) const override {
+        ECS_HISTORY_ZONE(zone, "apply change set");
+        ECS_HISTORY_ZONE_COUNT(zone, this->changes.size());
         change_applier_t<T> applier(reg.storage<T>(id), entities);
         for (const auto &change : this->changes) {
-            change->apply(applier);
+            visit(*change, applier);
+        }
+    }
+
+    void apply_range(entt::registry &reg,
+                     static_entities_t &entities,
+                     const size_t begin,
+                     const size_t end) const override {
+        change_applier_t<T> applier(reg.storage<T>(id), entities);
+        for (size_t i = begin; i < end; ++i) {
+            visit(*this->changes[i], applier);
         }
     }
 
     void serialize(cereal::PortableBinaryOutputArchive &archive) const override {
         change_serializer_t<T> serializer{archive};
         for (const auto &change : this->changes) {
-            change->apply(serializer);
+            visit(*change, serializer);
         }
     }
+
+    [[nodiscard]] static_entity_t entity_at(const size_t index) const override {
+        return this->changes[index]->static_entity;
+    }
+
+    [[nodiscard]] bool is_destruct(const size_t index) const override {
+        return this->changes[index]->type == change_type_t::DESTRUCT;
+    }
+
+    void serialize_change(const size_t index,
+                          cereal::PortableBinaryOutputArchive &archive) const override {
+        change_serializer_t<T> serializer{archive};
+        visit(*this->changes[index], serializer);
+    }
+
+    void serialize_change_body(const size_t index,
+                               cereal::PortableBinaryOutputArchive &archive) const override {
+        change_serializer_t<T> serializer{archive, false};
+        visit(*this->changes[index], serializer);
+    }
 };
 }
 
@@ -0,0 +1,152 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#ifndef ECS_HISTORY_CHECKSUM_HPP
+#define ECS_HISTORY_CHECKSUM_HPP
+
+#include <bit>
+#include <cstring>
+#include <sstream>
+
+#include <cereal/archives/portable_binary.hpp>
+
+#include "ecs_history/static_entity.hpp"
+#include "ecs_history/serialization/codec.hpp"
+
+namespace ecs_history {
+
+inline uint64_t mix_checksum(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+inline uint64_t hash_bytes(const void *data, const size_t size) {
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    uint64_t hash = size;
+    size_t offset = 0;
+    for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t)) {
+        uint64_t chunk;
+        std::memcpy(&chunk, bytes + offset, sizeof(uint64_t));
+        hash = mix_checksum(hash ^ chunk);
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, bytes + offset, size - offset);
+    return mix_checksum(hash ^ tail);
+}
+
+namespace detail {
+/**
+ * Hashes the cereal encoding of a value in little endian byte order. The archive is new for
+ * every value, as cereal writes class versions only the first time it sees a type.
+ */
+template<typename T>
+uint64_t serialized_checksum(const T &value) {
+    thread_local std::ostringstream stream;
+    stream.str({});
+    {
+        cereal::PortableBinaryOutputArchive archive(
+            stream,
+            cereal::PortableBinaryOutputArchive::Options::LittleEndian());
+        archive(value);
+    }
+    // Without the archive header
+    const auto bytes = stream.view().substr(1);
+    return hash_bytes(bytes.data(), bytes.size());
+}
+}
+
+/**
+ * Hashes a component value for registry checksums, the same way on every platform.
+ *
+ * Components with a codec are hashed in their encoded form, so lossy codecs give the same
+ * hash on both ends as long as encoding a decoded value gives the same bytes again. Values
+ * without padding are hashed as they are in memory on little endian hosts, all others in
+ * their cereal encoding. Empty components only contribute their entities.
+ */
+template<typename T>
+uint64_t value_checksum(const T &value) {
+    if constexpr (entt::component_traits<T>::page_size == 0u) {
+        return 0;
+    } else if constexpr (codec::has_codec<T>) {
+        using codec_type = typename codec_traits_t<T>::type;
+        std::array<uint8_t, (codec_type::bits + 7) / 8> bytes{};
+        codec::bit_writer_t writer{bytes.data()};
+        codec_type::encode(writer, value);
+        return hash_bytes(bytes.data(), bytes.size());
+    } else if constexpr (std::has_unique_object_representations_v<T> &&
+                         std::endian::native == std::endian::little) {
+        return hash_bytes(&value, sizeof(T));
+    } else {
+        static_assert(cereal::traits::is_output_serializable<T, cereal::PortableBinaryOutputArchive>::value,
+                      "Components need a codec, no padding or a cereal serialize function to be checksummed");
+        return detail::serialized_checksum(value);
+    }
+}
+
+/**
+ * Contribution of one component to the checksum of its storage.
+ */
+template<typename T>
+uint64_t checksum_of(const static_entity_t static_entity, const T &value) {
+    return mix_checksum(mix_checksum(static_entity) ^ value_checksum(value));
+}
+
+/**
+ * Replaces removed with added in the checksum of a storage if checksums are tracked.
+ * Either may be null.
+ */
+template<typename T>
+void track_checksum(static_entities_t &static_entities,
+                    const entt::id_type id,
+                    const static_entity_t static_entity,
+                    const T *removed,
+                    const T *added) {
+    if (!static_entities.has_checksum_tracking()) {
+        return;
+    }
+    static_entities.update_checksum(id,
+                                    removed == nullptr ? 0 : checksum_of(static_entity, *removed),
+                                    added == nullptr ? 0 : checksum_of(static_entity, *added));
+}
+
+/**
+ * Replaces the checksum of a storage with one computed from its contents.
+ */
+template<typename T>
+void recompute_checksum(const entt::sparse_set &base,
+                        const entt::id_type id,
+                        static_entities_t &static_entities) {
+    const auto &storage = static_cast<const entt::storage_type_t<T> &>(base);
+    uint64_t checksum = 0;
+    for (auto element : storage.each()) {
+        const auto static_entity = static_entities.get_static_entity(std::get<0>(element));
+        if constexpr (entt::component_traits<T>::page_size == 0u) {
+            checksum += checksum_of(static_entity, T{});
+        } else {
+            checksum += checksum_of(static_entity, std::get<1>(element));
+        }
+    }
+    static_entities.set_storage_checksum(id, checksum);
+}
+
+/**
+ * Recomputes all storage checksums, e.g. after loading a snapshot.
+ */
+template<typename ComponentRegistry>
+void recompute_checksums(entt::registry &reg, ComponentRegistry &component_registry) {
+    auto &static_entities = reg.ctx().get<static_entities_t>();
+    for (auto [id, storage] : reg.storage()) {
+        const entt::id_type component_id = storage.info().hash();
+        if (component_registry.contains(component_id)) {
+            component_registry.recompute_checksum(component_id, storage, static_entities);
+        }
+    }
+}
+}
+
+#endif //ECS_HISTORY_CHECKSUM_HPP
@@ -5,14 +5,20 @@
 #ifndef ECS_HISTORY_COMMIT_HPP
 #define ECS_HISTORY_COMMIT_HPP
 
+#include <array>
+#include <bit>
 #include <vector>
+#include <mutex>
+#include <optional>
 #include <random>
+#include <span>
 #include <spdlog/spdlog.h>
 #include <spdlog/fmt/ostr.h>
 #include <spdlog/fmt/compile.h>
 
 #include "ecs_history/change_set.hpp"
 #include "storage_monitor.hpp"
+#include "metrics.hpp"
 
 namespace ecs_history {
 struct commit_id {
@@ -45,9 +51,46 @@ public:
 };
 
 struct commit_t {
+private:
+    struct encoding_cache_t {
+        std::mutex mutex;
+        // Indexed by little endian, so each byte order is encoded at most once
+        std::array<std::shared_ptr<const std::string>, 2> bytes;
+
+        encoding_cache_t() = default;
+
+        encoding_cache_t(encoding_cache_t &&other) noexcept
+            : bytes(std::move(other.bytes)) {
+        }
+
+        encoding_cache_t &operator=(encoding_cache_t &&other) noexcept {
+            this->bytes = std::move(other.bytes);
+            return *this;
+        }
+    };
+
+    mutable encoding_cache_t encoding;
+
+public:
     bool undo = false;
     std::unordered_map<static_entity_t, entity_version_t> entity_versions;
     std::vector<std::unique_ptr<base_change_set_t> > change_sets;
+    /**
+     * Entities destroyed by this commit, sorted. Their versions before the commit are in
+     * entity_versions. Applying the commit removes whatever components they still have in one
+     * pass, so their destruct changes do not need to be sent.
+     */
+    std::vector<static_entity_t> destroyed_entities;
+    /**
+     * Components removed that way, captured on first apply so the commit can be inverted.
+     */
+    mutable std::vector<std::unique_ptr<base_change_set_t> > destroyed_components;
+    /**
+     * Registry checksum after this commit and the checksums of the storages it changed.
+     * Set by create_commit while checksums are tracked, see static_entities_t::set_checksum_tracking.
+     */
+    std::optional<uint64_t> checksum;
+    std::unordered_map<entt::id_type, uint64_t> storage_checksums;
 
     commit_t() = default;
 
@@ -62,7 +105,37 @@ struct commit_t {
 
     std::unique_ptr<commit_t> invert();
 
+    /**
+     * Returns the heap memory used by this commit, including its own allocation.
+     */
     [[nodiscard]] size_t size() const;
+
+    [[nodiscard]] size_t count() const;
+
+    /**
+     * Removes updates that do not change the value from all change sets of components
+     * with drop_noop_updates_t. Returns the number of removed changes.
+     */
+    size_t drop_noop_updates();
+
+    /**
+     * Returns this commit as written by serialize_commit into a fresh PortableBinaryOutputArchive
+     * with the given byte order. The bytes are computed once per byte order and shared by all
+     * callers, later calls only copy the pointer. Members that mutate the commit drop them;
+     * code assigning its fields directly after it was encoded has to call invalidate.
+     */
+    [[nodiscard]] std::shared_ptr<const std::string> encoded(std::endian byte_order = std::endian::native) const;
+
+    /**
+     * Uses already encoded bytes, e.g. the ones this commit was deserialized from.
+     * Their byte order is read from the archive header.
+     */
+    void set_encoded(std::shared_ptr<const std::string> bytes);
+
+    /**
+     * Drops the cached encodings, so the next encoded call encodes the commit again.
+     */
+    void invalidate();
 };
 
 std::unique_ptr<commit_t> create_commit(
@@ -72,9 +145,133 @@ std::unique_ptr<commit_t> create_commit(
 
 bool can_apply_commit(entt::registry &reg, const commit_t &commit);
 
+/**
+ * can_apply_commit for a run of commits applied one after another, without applying them.
+ */
+bool can_apply_commits(entt::registry &reg, std::span<const commit_t *const> commits);
+
+/**
+ * Returns false if the commit has a checksum that differs from the registry checksum.
+ * Only meaningful right after applying the commit on top of the state it was created from.
+ */
+bool checksum_matches(const static_entities_t &static_entities, const commit_t &commit);
+
+/**
+ * Returns the storages changed by the commit whose checksum differs from the registry.
+ * If none does, the divergence is older and comparing get_storage_checksums of both
+ * ends narrows it down.
+ */
+std::vector<entt::id_type> diverging_storages(const static_entities_t &static_entities,
+                                              const commit_t &commit);
+
+void apply_entity_versions(static_entities_t &static_entities, const commit_t &commit);
+
+/**
+ * Removes the destroyed entities of the commit that still exist, see commit_t::destroyed_entities.
+ * Monitors have to be disabled.
+ */
+void apply_destroyed_entities(entt::registry &reg,
+                              const std::vector<std::unique_ptr<base_storage_monitor_t> > &monitors,
+                              const commit_t &commit);
+
+/**
+ * apply_commit with every change set applied by apply_change_set(change_set, reg, static_entities),
+ * e.g. to dispatch them statically, see static_component_registry_t.
+ */
+template<typename ApplyChangeSet>
+void apply_commit_using(entt::registry &reg,
+                        const std::vector<std::unique_ptr<base_storage_monitor_t> > &monitors,
+                        const commit_t &commit,
+                        ApplyChangeSet &&apply_change_set) {
+    auto &static_entities = reg.ctx().get<static_entities_t>();
+    for (auto &monitor : monitors) {
+        monitor->disable();
+    }
+
+    apply_entity_versions(static_entities, commit);
+    for (const auto &change_set : commit.change_sets) {
+        apply_change_set(*change_set, reg, static_entities);
+        static_entities.mark_storage_changed(change_set->id);
+    }
+    apply_destroyed_entities(reg, monitors, commit);
+
+    for (auto &monitor : monitors) {
+        monitor->enable();
+    }
+}
+
 void apply_commit(entt::registry &reg,
                   const std::vector<std::unique_ptr<base_storage_monitor_t> > &monitors,
                   const commit_t &commit);
+
+/**
+ * Returns the net effect of the given commits, applied in order: one change per entity and
+ * component. Entity versions are the ones before the first commit touching each entity, so the
+ * result advances them by one step where the commits advance them by one per commit.
+ * To send the result in place of commits no one has seen yet, for example an unflushed outbound
+ * queue, pass the static entities: their versions are set back to that single step.
+ */
+std::unique_ptr<commit_t> coalesce_commits(std::span<const commit_t *const> commits);
+
+std::unique_ptr<commit_t> coalesce_commits(std::span<const commit_t *const> commits,
+                                           static_entities_t &static_entities);
+
+/**
+ * Applies a run of commits as if applied one by one with apply_commit, but with one monitor
+ * pass and one change per entity and component. The pre-images of the commits are filled,
+ * so each of them can still be inverted on its own. Falls back to applying them one by one
+ * if a commit touches an entity destroyed by an earlier one, or if can_apply_commits fails,
+ * as their changes may then not follow each other.
+ */
+void apply_commits(entt::registry &reg,
+                   const std::vector<std::unique_ptr<base_storage_monitor_t> > &monitors,
+                   std::span<const commit_t *const> commits);
+
+template<typename Metrics>
+std::unique_ptr<commit_t> create_commit(
+    const std::vector<std::unique_ptr<base_storage_monitor_t> > &monitors,
+    static_entities_t &static_entities,
+    Metrics &metrics) {
+    std::unique_ptr<commit_t> commit;
+    {
+        [[maybe_unused]] const auto timer = metrics.time(stage_t::CREATE_COMMIT);
+        commit = create_commit(monitors, static_entities);
+    }
+    if constexpr (Metrics::enabled) {
+        metrics.record_commit(commit->count());
+    }
+    return commit;
+}
+
+template<typename Metrics>
+void apply_commit(entt::registry &reg,
+                  const std::vector<std::unique_ptr<base_storage_monitor_t> > &monitors,
+                  const commit_t &commit,
+                  Metrics &metrics) {
+    {
+        [[maybe_unused]] const auto timer = metrics.time(stage_t::APPLY);
+        apply_commit(reg, monitors, commit);
+    }
+    if constexpr (Metrics::enabled) {
+        metrics.record_applied(commit.count());
+    }
+}
+
+template<typename Metrics>
+void apply_commits(entt::registry &reg,
+                   const std::vector<std::unique_ptr<base_storage_monitor_t> > &monitors,
+                   const std::span<const commit_t *const> commits,
+                   Metrics &metrics) {
+    {
+        [[maybe_unused]] const auto timer = metrics.time(stage_t::APPLY);
+        apply_commits(reg, monitors, commits);
+    }
+    if constexpr (Metrics::enabled) {
+        for (const auto *commit : commits) {
+            metrics.record_applied(commit->count());
+        }
+    }
+}
 }
 
 template<>
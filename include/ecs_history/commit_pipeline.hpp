@@ -0,0 +1,121 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#ifndef ECS_HISTORY_COMMIT_PIPELINE_HPP
+#define ECS_HISTORY_COMMIT_PIPELINE_HPP
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "ecs_history/commit.hpp"
+#include "ecs_history/concurrency/spsc_queue.hpp"
+
+namespace ecs_history {
+
+/**
+ * Serialized (and possibly compressed) commit ready to be sent.
+ */
+struct shipped_commit_t {
+    commit_id id;
+    std::shared_ptr<const std::string> bytes;
+};
+
+/**
+ * Moves serialization off the simulation thread.
+ *
+ * The simulation thread hands frozen commits to submit/try_submit, a worker thread
+ * serializes and optionally compresses them, and the network thread collects the
+ * results with poll. Both queues are bounded: when the worker falls behind,
+ * try_submit fails and submit blocks; when the network thread falls behind, the
+ * worker stops taking new commits.
+ *
+ * Submitted commits are shared with the worker and must not be modified until
+ * they are shipped. Applying them to a history is fine. Without a compressor the
+ * shipped bytes are the commit's cached encoding, so later serializations of the
+ * same commit are free.
+ *
+ * Combine with static_entities_t::set_eager_versions so create_commit does not
+ * depend on the commit size either.
+ */
+class commit_pipeline_t {
+public:
+    using compressor_t = std::function<std::string(std::string)>;
+    using completion_callback_t = std::function<void(commit_id id, size_t bytes)>;
+
+private:
+    struct job_t {
+        commit_id id;
+        std::shared_ptr<const commit_t> commit;
+    };
+
+    concurrency::spsc_queue_t<job_t> jobs;
+    concurrency::spsc_queue_t<shipped_commit_t> shipped;
+    compressor_t compressor;
+    completion_callback_t on_complete;
+    // Signals are counters, waiters sleep until the value they observed changes
+    std::atomic<uint32_t> job_signal{0};
+    // Space in the job queue, waited for by submit
+    std::atomic<uint32_t> job_space_signal{0};
+    std::atomic<uint32_t> shipped_signal{0};
+    // Space in the shipped queue, waited for by the worker
+    std::atomic<uint32_t> shipped_space_signal{0};
+    std::atomic<bool> stopping{false};
+    std::thread worker;
+
+    void run();
+
+    std::shared_ptr<const std::string> serialize(const commit_t &commit) const;
+
+public:
+    /**
+     * @param capacity Maximum number of commits waiting in each queue
+     * @param compressor Applied to the serialized bytes on the worker thread, may be empty
+     * @param on_complete Called on the worker thread once a commit was queued for shipping
+     */
+    explicit commit_pipeline_t(size_t capacity,
+                               compressor_t compressor = {},
+                               completion_callback_t on_complete = {});
+
+    commit_pipeline_t(const commit_pipeline_t &) = delete;
+
+    commit_pipeline_t &operator=(const commit_pipeline_t &) = delete;
+
+    /**
+     * Stops the worker after the queued commits were processed.
+     */
+    ~commit_pipeline_t();
+
+    /**
+     * Queues a commit for serialization. Returns false if the queue is full.
+     * May only be called from one thread.
+     */
+    bool try_submit(commit_id id, std::shared_ptr<const commit_t> commit);
+
+    /**
+     * Queues a commit for serialization, waiting while the queue is full.
+     * May only be called from the thread calling try_submit.
+     */
+    void submit(commit_id id, std::shared_ptr<const commit_t> commit);
+
+    /**
+     * Returns the next shipped commit, if any. May only be called from one thread.
+     */
+    std::optional<shipped_commit_t> poll();
+
+    /**
+     * Waits until a shipped commit is available. Returns nullopt once the pipeline stops.
+     * May only be called from the thread calling poll.
+     */
+    std::optional<shipped_commit_t> wait();
+
+    [[nodiscard]] size_t pending() const {
+        return this->jobs.size();
+    }
+};
+}
+
+#endif //ECS_HISTORY_COMMIT_PIPELINE_HPP
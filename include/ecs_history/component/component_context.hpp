@@ -4,7 +4,9 @@
 
 #ifndef ECS_HISTORY_COMPONENT_CONTEXT_HPP
 #define ECS_HISTORY_COMPONENT_CONTEXT_HPP
+#include <string_view>
 #include "ecs_history/change_set.hpp"
+#include "ecs_history/checksum.hpp"
 
 namespace ecs_history::registry {
 
@@ -12,8 +14,39 @@ struct component_t {
     virtual std::unique_ptr<base_change_set_t> deserialize_change_set(
         cereal::PortableBinaryInputArchive &archive) = 0;
 
+    virtual std::unique_ptr<base_change_set_t> deserialize_change_set(
+        cereal::PortableBinaryInputArchive &archive,
+        const entity_reader_t &read_entity) = 0;
+
     virtual void serialize_raw(const void *raw, cereal::PortableBinaryOutputArchive &archive) = 0;
 
+    /**
+     * Encodes a whole storage as a snapshot chunk. May be called from several threads at once.
+     */
+    [[nodiscard]] virtual std::string serialize_storage(const entt::sparse_set &storage,
+                                                        const static_entities_t &static_entities)
+    const = 0;
+
+    virtual void deserialize_storage(std::string_view chunk,
+                                     entt::registry &reg,
+                                     entt::id_type storage_id,
+                                     const std::vector<entt::entity> &entities,
+                                     std::vector<uint16_t> &refs) = 0;
+
+    /**
+     * Reads a storage written by serialize_registry and inserts it into reg.storage<T>(id) at once.
+     */
+    virtual void load_storage(entt::id_type id,
+                              cereal::PortableBinaryInputArchive &archive,
+                              entt::registry &reg) = 0;
+
+    /**
+     * Recomputes the checksum of a storage, see static_entities_t::set_checksum_tracking.
+     */
+    virtual void recompute_checksum(entt::id_type id,
+                                    const entt::sparse_set &storage,
+                                    static_entities_t &static_entities) const = 0;
+
     virtual ~component_t() = default;
 };
 
@@ -24,21 +57,79 @@ public:
     std::unique_ptr<base_change_set_t> deserialize_change_set(const entt::id_type id,
                                                               cereal::PortableBinaryInputArchive
                                                               &archive) {
-        if (!components.contains(id)) {
+        const auto it = components.find(id);
+        if (it == components.end()) {
             throw std::runtime_error("Tried to deserialize unknown component change set");
         }
-        component_t &component = *components[id];
-        return component.deserialize_change_set(archive);
+        return it->second->deserialize_change_set(archive);
+    }
+
+    std::unique_ptr<base_change_set_t> deserialize_change_set(const entt::id_type id,
+                                                              cereal::PortableBinaryInputArchive
+                                                              &archive,
+                                                              const entity_reader_t &read_entity) {
+        const auto it = components.find(id);
+        if (it == components.end()) {
+            throw std::runtime_error("Tried to deserialize unknown component change set");
+        }
+        return it->second->deserialize_change_set(archive, read_entity);
     }
 
     void serialize_raw(const entt::id_type id,
                        const void *raw,
                        cereal::PortableBinaryOutputArchive &archive) {
-        if (!components.contains(id)) {
+        const auto it = components.find(id);
+        if (it == components.end()) {
             throw std::runtime_error("Tried to serialize unknown component change set");
         }
-        component_t &component = *components[id];
-        component.serialize_raw(raw, archive);
+        it->second->serialize_raw(raw, archive);
+    }
+
+    [[nodiscard]] std::string serialize_storage(const entt::id_type id,
+                                                const entt::sparse_set &storage,
+                                                const static_entities_t &static_entities) const {
+        const auto it = components.find(id);
+        if (it == components.end()) {
+            throw std::runtime_error("Tried to serialize unknown component storage");
+        }
+        return it->second->serialize_storage(storage, static_entities);
+    }
+
+    void deserialize_storage(const entt::id_type id,
+                             const std::string_view chunk,
+                             entt::registry &reg,
+                             const entt::id_type storage_id,
+                             const std::vector<entt::entity> &entities,
+                             std::vector<uint16_t> &refs) {
+        const auto it = components.find(id);
+        if (it == components.end()) {
+            throw std::runtime_error("Tried to deserialize unknown component storage");
+        }
+        it->second->deserialize_storage(chunk, reg, storage_id, entities, refs);
+    }
+
+    void load_storage(const entt::id_type id,
+                      cereal::PortableBinaryInputArchive &archive,
+                      entt::registry &reg) {
+        const auto it = components.find(id);
+        if (it == components.end()) {
+            throw std::runtime_error("Tried to deserialize unknown component storage");
+        }
+        it->second->load_storage(id, archive, reg);
+    }
+
+    void recompute_checksum(const entt::id_type id,
+                            const entt::sparse_set &storage,
+                            static_entities_t &static_entities) const {
+        const auto it = components.find(id);
+        if (it == components.end()) {
+            throw std::runtime_error("Tried to checksum unknown component storage");
+        }
+        it->second->recompute_checksum(id, storage, static_entities);
+    }
+
+    [[nodiscard]] bool contains(const entt::id_type id) const {
+        return components.contains(id);
     }
 
     template<typename T>
@@ -7,25 +7,53 @@
 #include "component_context.hpp"
 #include "ecs_history/serialization/change.hpp"
 #include "ecs_history/serialization/serialization.hpp"
+#include "ecs_history/serialization/snapshot.hpp"
 
 namespace ecs_history {
 template<typename T>
 struct default_component_t final : registry::component_t {
     std::unique_ptr<base_change_set_t>
     deserialize_change_set(cereal::PortableBinaryInputArchive &archive) override {
-        auto change_set = std::make_unique<change_set_t<T> >();
-        uint32_t count;
-        archive(count);
-        for (uint32_t i = 0; i < count; ++i) {
-            std::unique_ptr<change_t<T> > change = serialization::deserialize_change<
-                cereal::PortableBinaryInputArchive, T>(archive);
-            change_set->add_change(std::move(change));
-        }
-        return std::move(change_set);
+        return serialization::deserialize_change_set<cereal::PortableBinaryInputArchive, T>(
+            archive);
+    }
+
+    std::unique_ptr<base_change_set_t>
+    deserialize_change_set(cereal::PortableBinaryInputArchive &archive,
+                           const entity_reader_t &read_entity) override {
+        return serialization::deserialize_change_set<cereal::PortableBinaryInputArchive, T>(
+            archive,
+            read_entity);
     }
 
     void serialize_raw(const void *raw, cereal::PortableBinaryOutputArchive &archive) override {
-        archive(*static_cast<const T *>(raw));
+        codec::save(archive, *static_cast<const T *>(raw));
+    }
+
+    [[nodiscard]] std::string serialize_storage(const entt::sparse_set &storage,
+                                                const static_entities_t &static_entities)
+    const override {
+        return serialization::encode_storage<T>(storage, static_entities);
+    }
+
+    void deserialize_storage(const std::string_view chunk,
+                             entt::registry &reg,
+                             const entt::id_type storage_id,
+                             const std::vector<entt::entity> &entities,
+                             std::vector<uint16_t> &refs) override {
+        serialization::decode_storage<T>(chunk, reg, storage_id, entities, refs);
+    }
+
+    void load_storage(const entt::id_type id,
+                      cereal::PortableBinaryInputArchive &archive,
+                      entt::registry &reg) override {
+        serialization::load_storage<cereal::PortableBinaryInputArchive, T>(archive, reg, id);
+    }
+
+    void recompute_checksum(const entt::id_type id,
+                            const entt::sparse_set &storage,
+                            static_entities_t &static_entities) const override {
+        ecs_history::recompute_checksum<T>(storage, id, static_entities);
     }
 
 };
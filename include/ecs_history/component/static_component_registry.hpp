@@ -0,0 +1,227 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#ifndef ECS_HISTORY_STATIC_COMPONENT_REGISTRY_HPP
+#define ECS_HISTORY_STATIC_COMPONENT_REGISTRY_HPP
+#include <algorithm>
+#include <array>
+#include <utility>
+
+#include "component_context.hpp"
+#include "ecs_history/commit.hpp"
+#include "ecs_history/serialization/change.hpp"
+#include "ecs_history/serialization/snapshot.hpp"
+
+namespace ecs_history::registry {
+
+/**
+ * Component registry for component sets known at compile time.
+ *
+ * Ids are looked up in a table of the type hashes of Ts..., sorted at compile time, which
+ * selects the entry of a jump table instantiated per type. Serialization, deserialization and
+ * application are therefore inlined per type without going through component_t, and applied
+ * changes are visited without virtual calls. Unknown ids are forwarded to an optional runtime
+ * registry, which keeps plugin components working.
+ */
+template<typename... Ts>
+class static_component_registry_t {
+    static constexpr size_t COUNT = sizeof...(Ts);
+
+    using entry_t = std::pair<entt::id_type, size_t>;
+
+    // Type hashes with the position of their type in Ts..., sorted by hash
+    static constexpr std::array<entry_t, COUNT> ENTRIES = [] {
+        size_t index = 0;
+        std::array<entry_t, COUNT> entries{entry_t{entt::type_hash<Ts>::value(), index++}...};
+        std::ranges::sort(entries);
+        return entries;
+    }();
+
+    static_assert(std::ranges::adjacent_find(ENTRIES,
+                                             {},
+                                             &entry_t::first) == ENTRIES.end(),
+                  "component types with the same type hash");
+
+    component_registry_t *fallback;
+
+    /**
+     * Position of the type with the given hash in Ts..., COUNT if there is none.
+     */
+    static constexpr size_t index_of(const entt::id_type id) {
+        const auto it = std::ranges::lower_bound(ENTRIES, id, {}, &entry_t::first);
+        return it != ENTRIES.end() && it->first == id ? it->second : COUNT;
+    }
+
+    template<typename Func, typename T>
+    static void invoke(Func &func) {
+        func.template operator()<T>();
+    }
+
+    template<typename Func>
+    static bool dispatch(const entt::id_type id, Func &&func) {
+        using func_t = std::remove_reference_t<Func>;
+        static constexpr std::array<void (*)(func_t &), COUNT> jump_table{&invoke<func_t, Ts>...};
+        const size_t index = index_of(id);
+        if (index == COUNT) {
+            return false;
+        }
+        jump_table[index](func);
+        return true;
+    }
+
+public:
+    explicit static_component_registry_t(component_registry_t *fallback = nullptr)
+        : fallback(fallback) {
+    }
+
+    template<typename Archive>
+    std::unique_ptr<base_change_set_t> deserialize_change_set(const entt::id_type id,
+                                                              Archive &archive) {
+        std::unique_ptr<base_change_set_t> change_set;
+        if (dispatch(id,
+                     [&]<typename T>() {
+                         change_set = serialization::deserialize_change_set<Archive, T>(archive);
+                     })) {
+            return change_set;
+        }
+        if (fallback != nullptr) {
+            return fallback->deserialize_change_set(id, archive);
+        }
+        throw std::runtime_error("Tried to deserialize unknown component change set");
+    }
+
+    template<typename Archive>
+    std::unique_ptr<base_change_set_t> deserialize_change_set(const entt::id_type id,
+                                                              Archive &archive,
+                                                              const entity_reader_t &read_entity) {
+        std::unique_ptr<base_change_set_t> change_set;
+        if (dispatch(id,
+                     [&]<typename T>() {
+                         change_set = serialization::deserialize_change_set<Archive, T>(
+                             archive,
+                             read_entity);
+                     })) {
+            return change_set;
+        }
+        if (fallback != nullptr) {
+            return fallback->deserialize_change_set(id, archive, read_entity);
+        }
+        throw std::runtime_error("Tried to deserialize unknown component change set");
+    }
+
+    template<typename Archive>
+    void serialize_raw(const entt::id_type id, const void *raw, Archive &archive) {
+        if (dispatch(id,
+                     [&]<typename T>() {
+                         codec::save(archive, *static_cast<const T *>(raw));
+                     })) {
+            return;
+        }
+        if (fallback != nullptr) {
+            fallback->serialize_raw(id, raw, archive);
+            return;
+        }
+        throw std::runtime_error("Tried to serialize unknown component change set");
+    }
+
+    [[nodiscard]] std::string serialize_storage(const entt::id_type id,
+                                                const entt::sparse_set &storage,
+                                                const static_entities_t &static_entities) const {
+        std::string chunk;
+        if (dispatch(id,
+                     [&]<typename T>() {
+                         chunk = serialization::encode_storage<T>(storage, static_entities);
+                     })) {
+            return chunk;
+        }
+        if (fallback != nullptr) {
+            return fallback->serialize_storage(id, storage, static_entities);
+        }
+        throw std::runtime_error("Tried to serialize unknown component storage");
+    }
+
+    void deserialize_storage(const entt::id_type id,
+                             const std::string_view chunk,
+                             entt::registry &reg,
+                             const entt::id_type storage_id,
+                             const std::vector<entt::entity> &entities,
+                             std::vector<uint16_t> &refs) {
+        if (dispatch(id,
+                     [&]<typename T>() {
+                         serialization::decode_storage<T>(chunk, reg, storage_id, entities, refs);
+                     })) {
+            return;
+        }
+        if (fallback != nullptr) {
+            fallback->deserialize_storage(id, chunk, reg, storage_id, entities, refs);
+            return;
+        }
+        throw std::runtime_error("Tried to deserialize unknown component storage");
+    }
+
+    template<typename Archive>
+    void load_storage(const entt::id_type id, Archive &archive, entt::registry &reg) {
+        if (dispatch(id,
+                     [&]<typename T>() {
+                         serialization::load_storage<Archive, T>(archive, reg, id);
+                     })) {
+            return;
+        }
+        if (fallback != nullptr) {
+            fallback->load_storage(id, archive, reg);
+            return;
+        }
+        throw std::runtime_error("Tried to deserialize unknown component storage");
+    }
+
+    void recompute_checksum(const entt::id_type id,
+                            const entt::sparse_set &storage,
+                            static_entities_t &static_entities) const {
+        if (dispatch(id,
+                     [&]<typename T>() {
+                         ecs_history::recompute_checksum<T>(storage, id, static_entities);
+                     })) {
+            return;
+        }
+        if (fallback != nullptr) {
+            fallback->recompute_checksum(id, storage, static_entities);
+            return;
+        }
+        throw std::runtime_error("Tried to checksum unknown component storage");
+    }
+
+    void apply(const base_change_set_t &change_set,
+               entt::registry &reg,
+               static_entities_t &static_entities) const {
+        if (!dispatch(change_set.id,
+                      [&]<typename T>() {
+                          static_cast<const change_set_t<T> &>(change_set).apply(
+                              reg,
+                              static_entities);
+                      })) {
+            change_set.apply(reg, static_entities);
+        }
+    }
+
+    void apply_commit(entt::registry &reg,
+                      const std::vector<std::unique_ptr<base_storage_monitor_t> > &monitors,
+                      const commit_t &commit) const {
+        ecs_history::apply_commit_using(reg,
+                                        monitors,
+                                        commit,
+                                        [this](const base_change_set_t &change_set,
+                                               entt::registry &registry,
+                                               static_entities_t &static_entities) {
+                                            this->apply(change_set, registry, static_entities);
+                                        });
+    }
+
+    [[nodiscard]] bool contains(const entt::id_type id) const {
+        return index_of(id) != COUNT || (fallback != nullptr && fallback->contains(id));
+    }
+};
+
+}
+
+#endif //ECS_HISTORY_STATIC_COMPONENT_REGISTRY_HPP
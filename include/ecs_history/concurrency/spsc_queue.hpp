@@ -0,0 +1,76 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#ifndef ECS_HISTORY_SPSC_QUEUE_HPP
+#define ECS_HISTORY_SPSC_QUEUE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <optional>
+#include <vector>
+
+namespace ecs_history::concurrency {
+
+/**
+ * Bounded lock-free queue for exactly one producer and one consumer thread.
+ */
+template<typename T>
+class spsc_queue_t {
+    std::vector<std::optional<T> > slots;
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+
+public:
+    explicit spsc_queue_t(const size_t capacity) : slots(std::max<size_t>(capacity, 1)) {
+    }
+
+    spsc_queue_t(const spsc_queue_t &) = delete;
+
+    spsc_queue_t &operator=(const spsc_queue_t &) = delete;
+
+    /**
+     * Pushes a value. Returns false without touching the value if the queue is full.
+     * May only be called from the producer thread.
+     */
+    bool try_push(T &value) {
+        const size_t current_tail = this->tail.load(std::memory_order_relaxed);
+        if (current_tail - this->head.load(std::memory_order_acquire) == this->slots.size()) {
+            return false;
+        }
+        this->slots[current_tail % this->slots.size()].emplace(std::move(value));
+        this->tail.store(current_tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * May only be called from the consumer thread.
+     */
+    std::optional<T> try_pop() {
+        const size_t current_head = this->head.load(std::memory_order_relaxed);
+        if (current_head == this->tail.load(std::memory_order_acquire)) {
+            return std::nullopt;
+        }
+        auto &slot = this->slots[current_head % this->slots.size()];
+        std::optional<T> value = std::move(slot);
+        slot.reset();
+        this->head.store(current_head + 1, std::memory_order_release);
+        return value;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return this->tail.load(std::memory_order_acquire) -
+               this->head.load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] size_t capacity() const {
+        return this->slots.size();
+    }
+
+    [[nodiscard]] bool empty() const {
+        return this->size() == 0;
+    }
+};
+}
+
+#endif //ECS_HISTORY_SPSC_QUEUE_HPP
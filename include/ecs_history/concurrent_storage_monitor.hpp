@@ -0,0 +1,253 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#ifndef ECS_HISTORY_CONCURRENT_STORAGE_MONITOR_HPP
+#define ECS_HISTORY_CONCURRENT_STORAGE_MONITOR_HPP
+
+#include <algorithm>
+#include <iterator>
+#include <optional>
+
+#include "ecs_history/storage_monitor.hpp"
+
+namespace ecs_history {
+
+inline size_t &current_worker_index() {
+    thread_local size_t index = 0;
+    return index;
+}
+
+/**
+ * Binds the calling thread to a change buffer of every concurrent monitor.
+ * Threads that never call this record into buffer 0.
+ */
+inline void set_worker_index(const size_t index) {
+    current_worker_index() = index;
+}
+
+/**
+ * Storage monitor that can be written from several threads at once.
+ *
+ * Every worker appends to its own buffer, selected by set_worker_index, and
+ * reference count updates are deferred until commit(). Changes are recorded by
+ * value and only turned into change records by commit(), so recording neither
+ * allocates (beyond growing the buffer) nor touches memory shared with other
+ * workers: EnTT only allows concurrent patches of different entities, so changes
+ * of one entity are numbered by a counter of that entity, and commit() restores
+ * their order even if different workers recorded them.
+ *
+ * commit() adds all references before releasing any, and releases are deferred to
+ * the end of create_commit (see static_entities_t::defer_release), so an entity
+ * losing its last component and gaining another one, in the same or another
+ * concurrent monitor, survives.
+ *
+ * Epochs and checksums of the storage and its entities are only updated by commit
+ * and clear, so incremental snapshots only see committed changes.
+ *
+ * Constructing or destroying components still has to happen on one thread at a
+ * time, while no worker patches the storage, and no entities may be created while
+ * workers are recording.
+ */
+template<typename T, typename Metrics = null_metrics_t>
+class concurrent_storage_monitor_t final : public base_storage_monitor_t {
+    struct pending_change_t {
+        static_entity_t static_entity;
+        change_type_t type;
+        // Position among the changes of the entity, see entity_sequences
+        uint32_t sequence;
+        // The constructed value, or the old value of updates and destructs
+        T value;
+        std::optional<T> new_value;
+    };
+
+    struct alignas(64) worker_buffer_t {
+        std::vector<pending_change_t> changes;
+    };
+
+    static_entities_t &entities;
+    entt::storage_type_t<T> &storage;
+    std::vector<worker_buffer_t> buffers;
+    // Changes recorded per entity, indexed by entity. Only written for entities being
+    // patched, which no two workers do at once. Resized on the threads that construct.
+    std::vector<uint32_t> entity_sequences;
+    [[no_unique_address]] typename Metrics::component_handle_t counters;
+
+    worker_buffer_t &buffer() {
+        return this->buffers.at(current_worker_index());
+    }
+
+    uint32_t next_sequence(const entt::entity entity) {
+        return this->entity_sequences.at(entt::to_entity(entity))++;
+    }
+
+    void reserve_sequences() {
+        if (this->entity_sequences.size() < this->storage.extent()) {
+            this->entity_sequences.resize(this->storage.extent());
+        }
+    }
+
+    /**
+     * Moves the changes of all buffers into one vector. Changes of one entity are in the
+     * order they were recorded, changes of different entities in no particular order.
+     */
+    std::vector<pending_change_t> take_pending() {
+        size_t count = 0;
+        size_t filled = 0;
+        for (const auto &buffer : this->buffers) {
+            count += buffer.changes.size();
+            filled += buffer.changes.empty() ? 0 : 1;
+        }
+        std::vector<pending_change_t> pending;
+        pending.reserve(count);
+        for (auto &buffer : this->buffers) {
+            std::ranges::move(buffer.changes, std::back_inserter(pending));
+            buffer.changes.clear();
+        }
+        if (filled > 1) {
+            // Only entities patched by several workers need it, but grouping is cheaper than
+            // finding them. Sequences may wrap, they are compared by their distance.
+            std::ranges::stable_sort(pending,
+                                     [](const pending_change_t &a, const pending_change_t &b) {
+                                         if (a.static_entity != b.static_entity) {
+                                             return a.static_entity < b.static_entity;
+                                         }
+                                         return static_cast<int32_t>(a.sequence - b.sequence) < 0;
+                                     });
+        }
+        return pending;
+    }
+
+    static std::unique_ptr<change_t<T> > to_change(pending_change_t &pending) {
+        switch (pending.type) {
+            case change_type_t::CONSTRUCT:
+                return std::make_unique<construct_change_t<T> >(pending.static_entity,
+                                                                 std::move(pending.value));
+            case change_type_t::UPDATE:
+                return std::make_unique<update_change_t<T> >(pending.static_entity,
+                                                              std::move(pending.value),
+                                                              std::move(*pending.new_value));
+            default:
+                return std::make_unique<destruct_change_t<T> >(pending.static_entity,
+                                                                std::move(pending.value));
+        }
+    }
+
+    /**
+     * Turns the pending changes into change records and applies their reference deltas.
+     */
+    std::vector<std::unique_ptr<change_t<T> > > take_changes() {
+        auto pending = this->take_pending();
+        std::vector<std::unique_ptr<change_t<T> > > changes;
+        changes.reserve(pending.size());
+        checksum_tracker_t<T> checksums{this->entities, this->id};
+        for (auto &change : pending) {
+            this->entities.touch(change.static_entity);
+            if (change.type == change_type_t::CONSTRUCT) {
+                [[maybe_unused]] const auto entity = this->entities.increase_ref(change.static_entity);
+            }
+            changes.push_back(to_change(change));
+            changes.back()->apply(checksums);
+        }
+        for (const auto &change : changes) {
+            if (change->type == change_type_t::DESTRUCT) {
+                this->entities.defer_release(change->static_entity);
+            }
+        }
+        return changes;
+    }
+
+public:
+    explicit concurrent_storage_monitor_t(static_entities_t &entities,
+                                          entt::storage_type_t<T> &storage,
+                                          const size_t workers) requires (!Metrics::enabled)
+        : concurrent_storage_monitor_t(entities, storage, workers, null_metrics()) {
+    }
+
+    explicit concurrent_storage_monitor_t(static_entities_t &entities,
+                                          entt::storage_type_t<T> &storage,
+                                          const size_t workers,
+                                          Metrics &metrics)
+        : base_storage_monitor_t(storage.info().hash()),
+          entities(entities),
+          storage(storage),
+          buffers(std::max<size_t>(workers, 1)),
+          counters(metrics.component(storage.info().hash())) {
+        this->enable();
+    }
+
+    std::unique_ptr<base_change_set_t> commit() override {
+        ECS_HISTORY_ZONE(zone, "monitor commit");
+        auto changes = this->take_changes();
+        ECS_HISTORY_ZONE_COUNT(zone, changes.size());
+        if (!changes.empty()) {
+            this->entities.mark_storage_changed(this->id);
+        }
+        return std::make_unique<change_set_t<T> >(changes, this->id);
+    }
+
+    std::unique_ptr<base_change_set_t> remove_entities(
+        const std::vector<static_entity_t> &removed) override {
+        return ecs_history::remove_entities<T>(this->storage, this->entities, this->id, removed);
+    }
+
+    /**
+     * Drops the recorded changes. Their references are still counted, releases at the
+     * next create_commit.
+     */
+    void clear() override {
+        this->entities.mark_storage_changed(this->id);
+        this->take_changes();
+    }
+
+    void enable() override {
+        // Components added while disabled are not seen by on_construct
+        this->reserve_sequences();
+        this->storage.on_construct().template connect<&concurrent_storage_monitor_t::on_construct>(
+            this);
+        this->storage.on_update().template connect<&concurrent_storage_monitor_t::on_update>(this);
+        this->storage.on_destroy().template connect<&concurrent_storage_monitor_t::on_destruct>(
+            this);
+    }
+
+    void on_construct(const entt::entity entity,
+                      const T &value) {
+        static_entity_t static_entity = this->entities.get_static_entity(entity);
+        this->counters.record_construct();
+        this->reserve_sequences();
+        this->buffer().changes.push_back(
+            {static_entity, change_type_t::CONSTRUCT, this->next_sequence(entity), value, std::nullopt});
+    }
+
+    void on_update(const entt::entity entity,
+                   const T &old_value,
+                   const T &new_value) {
+        if (is_noop_update(old_value, new_value)) {
+            return;
+        }
+        static_entity_t static_entity = this->entities.get_static_entity(entity);
+        this->counters.record_update();
+        this->buffer().changes.push_back(
+            {static_entity, change_type_t::UPDATE, this->next_sequence(entity), old_value, new_value});
+    }
+
+    void on_destruct(const entt::entity entity,
+                     const T &old_value) {
+        static_entity_t static_entity = this->entities.get_static_entity(entity);
+        this->counters.record_destruct();
+        this->buffer().changes.push_back(
+            {static_entity, change_type_t::DESTRUCT, this->next_sequence(entity), old_value, std::nullopt});
+    }
+
+    void disable() override {
+        this->storage.on_construct().template disconnect<&
+            concurrent_storage_monitor_t::on_construct>(this);
+        this->storage.on_update().template disconnect<&concurrent_storage_monitor_t::on_update>(
+            this);
+        this->storage.on_destroy().template disconnect<&
+            concurrent_storage_monitor_t::on_destruct>(this);
+    }
+};
+}
+
+#endif //ECS_HISTORY_CONCURRENT_STORAGE_MONITOR_HPP
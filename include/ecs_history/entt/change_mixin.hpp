@@ -325,9 +325,8 @@ public:
     template<typename... Func>
     decltype(auto) patch(const entity_type entt, Func &&... func) {
         const auto old_value = this->get(entt);
-        underlying_type::patch(entt, std::forward<Func>(func)...);
-        const auto new_value = this->get(entt);
-        update.publish(entt, old_value, new_value);
+        auto &new_value = underlying_type::patch(entt, std::forward<Func>(func)...);
+        update.publish(entt, old_value, std::as_const(new_value));
         return new_value;
     }
 
@@ -348,9 +347,9 @@ public:
         if (auto &reg = owner_or_assert(); !construction.empty()) {
             // fine as long as insert passes force_back true to try_emplace
             for (const auto to = underlying_type::size(); from != to; ++from) {
-                const auto &entt = underlying_type::operator[](from);
+                const auto &entt = underlying_type::base_type::operator[](from);
                 const auto &value = this->get(entt);
-                construction.publish(underlying_type::operator[](from));
+                construction.publish(entt, value);
             }
         }
     }
@@ -5,28 +5,124 @@
 #ifndef ECS_HISTORY_HISTORY_HPP
 #define ECS_HISTORY_HISTORY_HPP
 #include "ecs_history/commit.hpp"
+#include "ecs_history/history_index.hpp"
+#include "ecs_history/tracing.hpp"
 #include <spdlog/spdlog.h>
 
 namespace ecs_history {
 const commit_id FIRST_BASE_ID{0, 0};
 
-class history_t {
+template<typename Metrics = null_metrics_t>
+class basic_history_t {
     entt::registry &reg;
     std::vector<std::unique_ptr<base_storage_monitor_t> > &monitors;
+    Metrics &metrics;
+    size_t memory_usage = 0;
+    size_t memory_budget = 0;
+    history_index_t index;
+    // The index is built by the first query, so histories nobody queries never pay for it
+    bool indexed = false;
 
 public:
     struct history_commit_t {
         commit_id base_id;
         commit_id id;
-        std::unique_ptr<commit_t> commit;
+        std::shared_ptr<commit_t> commit;
+        size_t bytes = 0;
+        size_t sequence = 0;
     };
 
+    using iterator = typename std::list<history_commit_t>::iterator;
+
     std::list<history_commit_t> commits{};
 
-    explicit history_t(entt::registry &reg,
-                       std::vector<std::unique_ptr<base_storage_monitor_t> > &monitors)
+private:
+    /**
+     * Updates the bytes of a retained commit. Called again whenever applying it may have added
+     * memory, e.g. pre-images and the components of destroyed entities.
+     */
+    void track(const iterator it) {
+        // Sizes are only computed with a budget, so inserting stays independent of the commit size
+        if (this->memory_budget != 0) {
+            const size_t bytes = memory::list_node_bytes<history_commit_t>() + it->commit->size();
+            this->memory_usage = this->memory_usage - it->bytes + bytes;
+            it->bytes = bytes;
+        }
+    }
+
+    void erase(const iterator first, const iterator last) {
+        for (auto it = first; it != last; ++it) {
+            this->memory_usage -= it->bytes;
+            if (this->indexed) {
+                this->index.remove(it->id, it->sequence, *it->commit);
+            }
+        }
+        this->commits.erase(first, last);
+    }
+
+    void enforce_memory_budget() {
+        while (this->memory_budget != 0 && this->memory_usage > this->memory_budget &&
+               this->commits.size() > 1) {
+            spdlog::debug("dropping oldest commit to stay within memory budget");
+            this->erase(this->commits.begin(), std::next(this->commits.begin()));
+        }
+    }
+
+    iterator insert(const iterator pos,
+                    const commit_id base_id,
+                    const commit_id id,
+                    std::shared_ptr<commit_t> commit) {
+        const auto it = this->commits.insert(pos, {base_id, id, std::move(commit)});
+        this->track(it);
+        // Sequences only have to be ordered, later commits are renumbered if they collide
+        size_t sequence = it == this->commits.begin() ? 0 : std::prev(it)->sequence + 1;
+        for (auto next = it; next != this->commits.end() && next->sequence <= sequence; ++next) {
+            next->sequence = sequence++;
+        }
+        if (this->indexed) {
+            this->index.add(it->id, it->sequence, *it->commit);
+        }
+        return it;
+    }
+
+    /**
+     * Applies a retained commit again after a rollback. Its destroyed entities may only exist
+     * now, so the components they lose are indexed again.
+     */
+    void reapply(const iterator it) {
+        const size_t captured = it->commit->destroyed_components.size();
+        ecs_history::apply_commit(this->reg, this->monitors, *it->commit);
+        this->track(it);
+        if (this->indexed && it->commit->destroyed_components.size() != captured) {
+            this->index.remove(it->id, it->sequence, *it->commit);
+            this->index.add(it->id, it->sequence, *it->commit);
+        }
+    }
+
+    const history_index_t &indexed_commits() {
+        if (!this->indexed) {
+            for (const auto &commit : this->commits) {
+                this->index.add(commit.id, commit.sequence, *commit.commit);
+            }
+            this->indexed = true;
+        }
+        return this->index;
+    }
+
+public:
+
+    explicit basic_history_t(entt::registry &reg,
+                             std::vector<std::unique_ptr<base_storage_monitor_t> > &monitors)
+        requires (!Metrics::enabled)
+        : basic_history_t(reg, monitors, null_metrics()) {
+    }
+
+    explicit basic_history_t(entt::registry &reg,
+                             std::vector<std::unique_ptr<base_storage_monitor_t> > &monitors,
+                             Metrics &metrics)
         : reg(reg),
-          monitors(monitors) {
+          monitors(monitors),
+          metrics(metrics) {
     }
 
     void apply_commit(const commit_id base_id,
@@ -41,89 +137,248 @@ public:
         // a base_id of {0, 0} means that this was an initial commit
         if (rit == rview.end() && base_id.part1 != 0 && base_id.part2 != 0) {
             spdlog::warn("commit with id == base_id not found. cannot apply commit");
+            this->metrics.record_rejected();
             return;
             throw std::runtime_error("commit with id == base_id not found. cannot apply commit");
         }
         if (const auto it = rit.base(); it == this->commits.end()) {
             // The new commit's base_id is the last commit's id -> just insert
             spdlog::debug("commit is recent. applying");
-            ecs_history::apply_commit(this->reg, this->monitors, *commit);
-            this->commits.emplace_back(base_id, id, std::move(commit));
+            ecs_history::apply_commit(this->reg, this->monitors, *commit, this->metrics);
+            this->insert(this->commits.end(), base_id, id, std::move(commit));
         } else {
             const auto base_it = std::prev(it); // The commit with the provided base_id
             // Rollback commits after commit with base_id = id
-            spdlog::debug("rolling back {} commits", std::distance(it, this->commits.end()));
-            for (auto rollback_it = --this->commits.end(); rollback_it != base_it; --rollback_it) {
-                spdlog::debug("rolling back {}{}", rollback_it->id.part1, rollback_it->id.part2);
-                ecs_history::apply_commit(this->reg,
-                                          this->monitors,
-                                          *rollback_it->commit->invert());
+            const auto rollback_depth = std::distance(it, this->commits.end());
+            spdlog::debug("rolling back {} commits", rollback_depth);
+            {
+                ECS_HISTORY_ZONE(zone, "rollback");
+                ECS_HISTORY_ZONE_COUNT(zone, rollback_depth);
+                [[maybe_unused]] const auto timer = this->metrics.time(stage_t::ROLLBACK);
+                for (auto rollback_it = --this->commits.end(); rollback_it != base_it; --
+                     rollback_it) {
+                    spdlog::debug("rolling back {}{}",
+                                  rollback_it->id.part1,
+                                  rollback_it->id.part2);
+                    ecs_history::apply_commit(this->reg,
+                                              this->monitors,
+                                              *rollback_it->commit->invert());
+                }
             }
+            this->metrics.record_rollback(rollback_depth);
             // Insert the new commit
             if (!can_apply_commit(this->reg, *commit)) {
+                this->metrics.record_rejected();
                 throw std::runtime_error("Failed to apply commit received from parent");
             }
             spdlog::debug("applying commit");
-            ecs_history::apply_commit(this->reg, this->monitors, *commit);
-            auto inserted_it = this->commits.insert(it, {base_id, id, std::move(commit)});
+            ecs_history::apply_commit(this->reg, this->monitors, *commit, this->metrics);
+            auto inserted_it = this->insert(it, base_id, id, std::move(commit));
             // Try to reapply rolledback commits
             auto applyagain_it = ++inserted_it;
-            for (; applyagain_it != this->commits.end(); ++applyagain_it) {
-                spdlog::debug("trying to rebase {}{}",
-                              applyagain_it->id.part1,
-                              applyagain_it->id.part2);
-                if (can_apply_commit(this->reg, *applyagain_it->commit)) {
-                    spdlog::debug("rebased {}{}",
+            {
+                ECS_HISTORY_ZONE(zone, "rebase");
+                [[maybe_unused]] const auto timer = this->metrics.time(stage_t::REBASE);
+                for (; applyagain_it != this->commits.end(); ++applyagain_it) {
+                    spdlog::debug("trying to rebase {}{}",
                                   applyagain_it->id.part1,
                                   applyagain_it->id.part2);
-                    ecs_history::apply_commit(this->reg,
-                                              this->monitors,
-                                              *applyagain_it->commit);
-                } else {
-                    break;
+                    if (can_apply_commit(this->reg, *applyagain_it->commit)) {
+                        spdlog::debug("rebased {}{}",
+                                      applyagain_it->id.part1,
+                                      applyagain_it->id.part2);
+                        this->reapply(applyagain_it);
+                    } else {
+                        break;
+                    }
                 }
+                ECS_HISTORY_ZONE_COUNT(zone, std::distance(inserted_it, applyagain_it));
             }
-            spdlog::debug("rebased {} commits", std::distance(inserted_it, applyagain_it));
-            spdlog::debug("removing {} commits (could not be rebased)",
-                          std::distance(applyagain_it, this->commits.end()));
+            const auto rebased = std::distance(inserted_it, applyagain_it);
+            const auto dropped = std::distance(applyagain_it, this->commits.end());
+            this->metrics.record_rebase(rebased, dropped);
+            spdlog::debug("rebased {} commits", rebased);
+            spdlog::debug("removing {} commits (could not be rebased)", dropped);
             // Remove commits we could not apply
-            this->commits.erase(applyagain_it, this->commits.end());
+            this->erase(applyagain_it, this->commits.end());
+        }
+        this->enforce_memory_budget();
+    }
+
+    struct pending_commit_t {
+        commit_id base_id;
+        commit_id id;
+        std::unique_ptr<commit_t> commit;
+    };
+
+    /**
+     * Applies received commits in order, e.g. the backlog of a reconnecting client. Runs of
+     * commits continuing the history are applied in one pass, see ecs_history::apply_commits,
+     * and stored one by one, so rolling them back works as with apply_commit. Other commits
+     * go through apply_commit.
+     */
+    void apply_commits(std::vector<pending_commit_t> &pending) {
+        size_t begin = 0;
+        while (begin < pending.size()) {
+            auto tail = this->commits.empty() ? FIRST_BASE_ID : this->commits.back().id;
+            size_t end = begin;
+            while (end < pending.size() && pending[end].base_id == tail) {
+                tail = pending[end++].id;
+            }
+            if (end - begin < 2) {
+                this->apply_commit(pending[begin].base_id, pending[begin].id, pending[begin].commit);
+                begin++;
+                continue;
+            }
+            spdlog::debug("applying {} commits in one pass", end - begin);
+            std::vector<const commit_t *> run;
+            run.reserve(end - begin);
+            for (size_t i = begin; i < end; ++i) {
+                run.push_back(pending[i].commit.get());
+            }
+            ecs_history::apply_commits(this->reg, this->monitors, run, this->metrics);
+            for (; begin < end; ++begin) {
+                this->insert(this->commits.end(),
+                             pending[begin].base_id,
+                             pending[begin].id,
+                             std::move(pending[begin].commit));
+            }
+            this->enforce_memory_budget();
         }
     }
 
     commit_id push_commit(const commit_id id,
                           std::unique_ptr<commit_t> &commit) {
         spdlog::debug("pushing commit {}{}", id.part1, id.part2);
-        if (this->commits.empty()) {
-            this->commits.push_back({FIRST_BASE_ID, id, std::move(commit)});
-            ecs_history::apply_commit(this->reg,
-                                      this->monitors,
-                                      *this->commits.back().commit);
-            return {0, 0};
-        }
-        const auto new_base_id = commits.back().id;
-        this->commits.push_back({new_base_id, id, std::move(commit)});
+        const auto new_base_id = this->commits.empty() ? FIRST_BASE_ID : commits.back().id;
+        // Applied before it is indexed, as applying captures the components of destroyed entities
         ecs_history::apply_commit(this->reg,
                                   this->monitors,
-                                  *this->commits.back().commit);
+                                  *commit,
+                                  this->metrics);
+        this->insert(this->commits.end(), new_base_id, id, std::move(commit));
+        this->enforce_memory_budget();
         return new_base_id;
     }
 
+    /**
+     * Stores an already applied commit. The commit may be shared,
+     * e.g. with a commit_pipeline_t serializing it in the background.
+     */
+    void add_commit(const commit_id base_id,
+                    const commit_id id,
+                    std::shared_ptr<commit_t> commit) {
+        this->insert(this->commits.end(), base_id, id, std::move(commit));
+        this->enforce_memory_budget();
+    }
+
     void add_commit(const commit_id base_id,
                     const commit_id id,
                     std::unique_ptr<commit_t> &commit) {
-        this->commits.push_back({base_id, id, std::move(commit)});
+        this->add_commit(base_id, id, std::shared_ptr<commit_t>(std::move(commit)));
+    }
+
+    commit_id add_commit(const commit_id id,
+                         std::shared_ptr<commit_t> commit) {
+        const auto new_base_id = this->commits.empty() ? FIRST_BASE_ID : commits.back().id;
+        this->add_commit(new_base_id, id, std::move(commit));
+        return new_base_id;
     }
 
     commit_id add_commit(const commit_id id,
                          std::unique_ptr<commit_t> &commit) {
-        if (this->commits.empty()) {
-            this->commits.push_back({FIRST_BASE_ID, id, std::move(commit)});
-            return {0, 0};
+        return this->add_commit(id, std::shared_ptr<commit_t>(std::move(commit)));
+    }
+
+    /**
+     * Returns the heap memory used by the retained commits, including the list nodes.
+     */
+    [[nodiscard]] size_t memory_size() const {
+        if (this->memory_budget != 0) {
+            return this->memory_usage;
         }
-        const auto new_base_id = commits.back().id;
-        this->commits.push_back({new_base_id, id, std::move(commit)});
-        return new_base_id;
+        size_t bytes = 0;
+        for (const auto &commit : this->commits) {
+            bytes += memory::list_node_bytes<history_commit_t>() + commit.commit->size();
+        }
+        return bytes;
+    }
+
+    /**
+     * Drops the oldest commits whenever the retained commits use more than the given
+     * amount of memory. The most recent commit is always kept. 0 disables the budget.
+     */
+    void set_memory_budget(const size_t bytes) {
+        this->memory_budget = bytes;
+        this->memory_usage = 0;
+        for (auto it = this->commits.begin(); it != this->commits.end(); ++it) {
+            it->bytes = 0;
+            this->track(it);
+        }
+        this->enforce_memory_budget();
+    }
+
+    /**
+     * Returns the value a component had right after the given commit, without touching the registry.
+     * The first query indexes the retained commits; afterwards the index is kept up to date as
+     * commits are added and dropped.
+     * Answered from the retained commits; components not changed by any of them are read from
+     * the registry, without creating missing storages. Costs time logarithmic in the retained
+     * changes of the component.
+     */
+    template<typename T>
+    std::optional<T> value_at(const static_entity_t static_entity,
+                              const commit_id id,
+                              const entt::id_type storage_id = entt::type_hash<T>::value()) {
+        const auto &index = this->indexed_commits();
+        const auto sequence = index.sequence_of(id);
+        if (!sequence.has_value()) {
+            throw std::runtime_error("commit is not part of the history");
+        }
+        std::optional<T> value;
+        if (index.template value_at<T>(static_entity, storage_id, *sequence, value)) {
+            return value;
+        }
+        const auto &static_entities = this->reg.ctx().template get<static_entities_t>();
+        if (!static_entities.has_entity(static_entity)) {
+            return std::nullopt;
+        }
+        const auto *base = this->reg.storage(storage_id);
+        const auto entt = static_entities.get_entity(static_entity);
+        if (base == nullptr || !base->contains(entt)) {
+            return std::nullopt;
+        }
+        if constexpr (entt::component_traits<T>::page_size == 0u) {
+            return T{};
+        } else {
+            return static_cast<const entt::storage_type_t<T> &>(*base).get(entt);
+        }
+    }
+
+    /**
+     * Returns every retained change of an entity, oldest commit first.
+     * The references stay valid until the referenced commit is removed from the history.
+     */
+    [[nodiscard]] std::vector<change_ref_t> changes_of(const static_entity_t static_entity) {
+        return this->indexed_commits().changes_of(static_entity);
+    }
+
+    /**
+     * Returns every retained change of one component of an entity, oldest first.
+     * The span is valid until the next commit is added to or removed from the history.
+     */
+    [[nodiscard]] std::span<const change_ref_t> changes_of(const static_entity_t static_entity,
+                                                           const entt::id_type component) {
+        return this->indexed_commits().changes_of(static_entity, component);
+    }
+
+    /**
+     * Returns the given components of an entity right after the given commit.
+     */
+    template<typename... Ts>
+    std::tuple<std::optional<Ts>...> entity_at(const static_entity_t static_entity,
+                                               const commit_id id) {
+        return {this->template value_at<Ts>(static_entity, id)...};
     }
 
     bool is_known_commit(const commit_id id) {
@@ -133,6 +388,8 @@ public:
                                    });
     }
 };
+
+using history_t = basic_history_t<>;
 }
 
 #endif //ECS_HISTORY_HISTORY_HPP
\ No newline at end of file
@@ -0,0 +1,237 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#ifndef ECS_HISTORY_HISTORY_INDEX_HPP
+#define ECS_HISTORY_HISTORY_INDEX_HPP
+
+#include <algorithm>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <unordered_set>
+#include <vector>
+
+#include "ecs_history/commit.hpp"
+
+namespace ecs_history {
+
+struct commit_id_hash_t {
+    size_t operator()(const commit_id &id) const {
+        return std::hash<uint64_t>{}(id.part1 ^ id.part2 * 0x9E3779B97F4A7C15ULL);
+    }
+};
+
+/**
+ * Reference to a single change retained in a history.
+ */
+struct change_ref_t {
+    /**
+     * Position of the commit in the history, kept up to date by the history
+     */
+    const size_t *position;
+    const base_change_set_t *change_set;
+    uint32_t offset;
+
+    [[nodiscard]] size_t sequence() const {
+        return *this->position;
+    }
+
+    [[nodiscard]] entt::id_type component() const {
+        return this->change_set->id;
+    }
+};
+
+/**
+ * Reads the value of a component before or after a change.
+ */
+template<typename T>
+class value_reader_t final : public change_supplier_t<T> {
+    const bool after;
+
+public:
+    std::optional<T> value;
+
+    explicit value_reader_t(const bool after) : after(after) {
+    }
+
+    void apply(const construct_change_t<T> &c) override {
+        if (after) {
+            value = c.value.get();
+        }
+    }
+
+    void apply(const update_change_t<T> &c) override {
+        value = after ? c.new_value.get() : c.old_value.get();
+    }
+
+    void apply(const destruct_change_t<T> &c) override {
+        if (!after) {
+            value = c.old_value.get();
+        }
+    }
+};
+
+/**
+ * Index of the changes of every component of every entity in a history.
+ *
+ * The history adds and removes commits as it changes, so queries only cost time
+ * proportional to the changes of the component. Positions are shared with the history,
+ * which renumbers commits after inserting one in the middle.
+ */
+class history_index_t {
+    struct key_t {
+        static_entity_t static_entity;
+        entt::id_type component;
+
+        bool operator==(const key_t &other) const = default;
+    };
+
+    struct key_hash_t {
+        size_t operator()(const key_t &key) const {
+            return std::hash<uint64_t>{}(key.static_entity * 0x9E3779B97F4A7C15ULL ^ key.component);
+        }
+    };
+
+    // Ordered by position
+    std::unordered_map<key_t, std::vector<change_ref_t>, key_hash_t> changes;
+    // Components with retained changes of every entity
+    std::unordered_map<static_entity_t, std::vector<entt::id_type> > components;
+    std::unordered_map<commit_id, const size_t *, commit_id_hash_t> positions;
+
+    /**
+     * Calls f with the change sets of a commit, followed by the components its destroyed
+     * entities lost when it was applied, as those are only removed after all other changes.
+     */
+    template<typename F>
+    static void for_each_change_set(const commit_t &commit, F &&f) {
+        for (const auto &change_set : commit.change_sets) {
+            f(*change_set);
+        }
+        for (const auto &change_set : commit.destroyed_components) {
+            f(*change_set);
+        }
+    }
+
+public:
+    /**
+     * Indexes a commit. position has to outlive its removal and be ordered with the
+     * positions of the other indexed commits.
+     */
+    void add(const commit_id id, const size_t &position, const commit_t &commit) {
+        this->positions[id] = &position;
+        for_each_change_set(commit, [this, &position](const base_change_set_t &change_set) {
+            const size_t count = change_set.count();
+            for (size_t i = 0; i < count; ++i) {
+                const auto static_entity = change_set.entity_at(i);
+                auto &refs = this->changes[{static_entity, change_set.id}];
+                if (refs.empty()) {
+                    this->components[static_entity].push_back(change_set.id);
+                }
+                const change_ref_t ref{&position, &change_set, static_cast<uint32_t>(i)};
+                if (refs.empty() || refs.back().sequence() <= position) {
+                    refs.push_back(ref);
+                } else {
+                    // Commit inserted before already indexed ones
+                    refs.insert(std::ranges::upper_bound(refs,
+                                                         position,
+                                                         {},
+                                                         &change_ref_t::sequence),
+                                ref);
+                }
+            }
+        });
+    }
+
+    void remove(const commit_id id, const size_t &position, const commit_t &commit) {
+        this->positions.erase(id);
+        std::unordered_set<key_t, key_hash_t> keys;
+        for_each_change_set(commit, [&keys](const base_change_set_t &change_set) {
+            change_set.for_entity([&keys, &change_set](const static_entity_t static_entity) {
+                keys.insert({static_entity, change_set.id});
+            });
+        });
+        for (const auto &key : keys) {
+            const auto it = this->changes.find(key);
+            if (it == this->changes.end()) {
+                continue;
+            }
+            std::erase_if(it->second,
+                          [&position](const change_ref_t &ref) {
+                              return ref.position == &position;
+                          });
+            if (!it->second.empty()) {
+                continue;
+            }
+            this->changes.erase(it);
+            const auto components = this->components.find(key.static_entity);
+            std::erase(components->second, key.component);
+            if (components->second.empty()) {
+                this->components.erase(components);
+            }
+        }
+    }
+
+    [[nodiscard]] std::optional<size_t> sequence_of(const commit_id id) const {
+        const auto it = this->positions.find(id);
+        if (it == this->positions.end()) {
+            return std::nullopt;
+        }
+        return *it->second;
+    }
+
+    /**
+     * Returns all retained changes of an entity, oldest commit first.
+     */
+    [[nodiscard]] std::vector<change_ref_t> changes_of(const static_entity_t static_entity) const {
+        std::vector<change_ref_t> refs;
+        const auto it = this->components.find(static_entity);
+        if (it == this->components.end()) {
+            return refs;
+        }
+        for (const auto component : it->second) {
+            const auto of_component = this->changes_of(static_entity, component);
+            refs.insert(refs.end(), of_component.begin(), of_component.end());
+        }
+        std::ranges::stable_sort(refs, {}, &change_ref_t::sequence);
+        return refs;
+    }
+
+    /**
+     * Returns the retained changes of one component of an entity, oldest first.
+     */
+    [[nodiscard]] std::span<const change_ref_t> changes_of(const static_entity_t static_entity,
+                                                           const entt::id_type component) const {
+        const auto it = this->changes.find({static_entity, component});
+        if (it == this->changes.end()) {
+            return {};
+        }
+        return it->second;
+    }
+
+    /**
+     * Returns the value of the component after the commit at sequence was applied, or nullopt
+     * if the component did not exist then. Returns false if no retained change touched it.
+     */
+    template<typename T>
+    bool value_at(const static_entity_t static_entity,
+                  const entt::id_type component,
+                  const size_t sequence,
+                  std::optional<T> &value) const {
+        const auto refs = this->changes_of(static_entity, component);
+        if (refs.empty()) {
+            return false;
+        }
+        // The last change up to sequence tells the value after it, otherwise the first later one the value before it
+        const auto next = std::ranges::upper_bound(refs, sequence, {}, &change_ref_t::sequence);
+        const bool after = next != refs.begin();
+        const auto &found = after ? *std::prev(next) : *next;
+        value_reader_t<T> reader{after};
+        static_cast<const change_set_t<T> *>(found.change_set)->at(found.offset).apply(reader);
+        value = std::move(reader.value);
+        return true;
+    }
+};
+}
+
+#endif //ECS_HISTORY_HISTORY_INDEX_HPP
@@ -0,0 +1,96 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#ifndef ECS_HISTORY_INCREMENTAL_APPLY_HPP
+#define ECS_HISTORY_INCREMENTAL_APPLY_HPP
+
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <optional>
+
+#include "ecs_history/commit.hpp"
+
+namespace ecs_history {
+
+/**
+ * Limits how much of a commit incremental_apply_t::step applies.
+ */
+struct apply_budget_t {
+    size_t max_changes = std::numeric_limits<size_t>::max();
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+
+    static apply_budget_t changes(const size_t max_changes) {
+        return {max_changes, std::nullopt};
+    }
+
+    static apply_budget_t until(const std::chrono::steady_clock::time_point deadline) {
+        return {std::numeric_limits<size_t>::max(), deadline};
+    }
+
+    static apply_budget_t time(const std::chrono::steady_clock::duration duration) {
+        return until(std::chrono::steady_clock::now() + duration);
+    }
+};
+
+/**
+ * Applies a commit over several frames.
+ *
+ * The first step applies the entity versions and disables the monitors, every step then
+ * applies changes until its budget is used up, and the step that applies the last change
+ * enables the monitors again and returns true. The registry is only consistent once the
+ * commit is fully applied, and the monitored storages must not be modified in between,
+ * as those modifications would not be recorded.
+ */
+class incremental_apply_t {
+    // Deadlines are checked after this many changes
+    static constexpr size_t CLOCK_INTERVAL = 256;
+
+    entt::registry &reg;
+    const std::vector<std::unique_ptr<base_storage_monitor_t> > &monitors;
+    std::shared_ptr<const commit_t> commit;
+    size_t change_set = 0;
+    size_t offset = 0;
+    size_t applied_changes = 0;
+    bool started = false;
+    bool finished = false;
+
+    void start();
+
+    void finish();
+
+public:
+    incremental_apply_t(entt::registry &reg,
+                        const std::vector<std::unique_ptr<base_storage_monitor_t> > &monitors,
+                        std::shared_ptr<const commit_t> commit);
+
+    incremental_apply_t(const incremental_apply_t &) = delete;
+
+    incremental_apply_t &operator=(const incremental_apply_t &) = delete;
+
+    /**
+     * Enables the monitors again if the commit was only partially applied.
+     */
+    ~incremental_apply_t();
+
+    /**
+     * Applies changes until the budget is used up. Returns true once the commit is fully applied.
+     */
+    bool step(const apply_budget_t &budget);
+
+    [[nodiscard]] bool done() const {
+        return this->finished;
+    }
+
+    [[nodiscard]] size_t applied() const {
+        return this->applied_changes;
+    }
+
+    [[nodiscard]] size_t total() const {
+        return this->commit->count();
+    }
+};
+}
+
+#endif //ECS_HISTORY_INCREMENTAL_APPLY_HPP
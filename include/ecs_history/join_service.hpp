@@ -0,0 +1,186 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#ifndef ECS_HISTORY_JOIN_SERVICE_HPP
+#define ECS_HISTORY_JOIN_SERVICE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ecs_history/commit.hpp"
+#include "ecs_history/commit_pipeline.hpp"
+#include "ecs_history/serialization/snapshot.hpp"
+
+namespace ecs_history {
+
+/**
+ * What a late joiner needs: load the snapshot, then apply the commits in order.
+ * The first commit is based on snapshot_id, every further one on the one before it.
+ */
+struct join_state_t {
+    commit_id snapshot_id;
+    std::shared_ptr<const std::string> snapshot;
+    std::vector<shipped_commit_t> commits;
+};
+
+/**
+ * Serves late joiners from a cached snapshot instead of serializing the registry per joiner.
+ *
+ * The service keeps a replica of the registry on a worker thread, fed with the encoded bytes
+ * of every published commit. Once the cached snapshot is older than max_age and commits were
+ * published since, the worker writes a new snapshot of the replica, which is consistent with
+ * the commit it last applied, so the simulation thread never waits for a snapshot after the
+ * first one. Joiners get the cached snapshot and the commits published after it; any number
+ * of joiners between two snapshots share the same bytes.
+ *
+ * The component registry is used from the worker thread, so it must not be modified.
+ */
+template<typename ComponentRegistry = registry::component_registry_t>
+class join_service_t {
+    ComponentRegistry &component_registry;
+    const std::chrono::steady_clock::duration max_age;
+    entt::registry replica;
+    // The replica is not monitored, applied commits are not recorded again
+    const std::vector<std::unique_ptr<base_storage_monitor_t> > no_monitors;
+    commit_id replica_id;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<shipped_commit_t> queued;
+    std::vector<shipped_commit_t> since;
+    commit_id snapshot_id;
+    std::shared_ptr<const std::string> snapshot;
+    std::chrono::steady_clock::time_point snapshot_time;
+    size_t snapshot_count = 1;
+    bool stopping = false;
+    std::thread worker;
+
+    void run() {
+        const auto ready = [this] {
+            return this->stopping || !this->queued.empty();
+        };
+        std::unique_lock lock(this->mutex);
+        while (true) {
+            if (this->replica_id == this->snapshot_id) {
+                this->wake.wait(lock, ready);
+            } else {
+                this->wake.wait_until(lock, this->snapshot_time + this->max_age, ready);
+            }
+            if (this->stopping) {
+                return;
+            }
+            std::vector<shipped_commit_t> batch(this->queued.begin(), this->queued.end());
+            this->queued.clear();
+            lock.unlock();
+
+            for (const auto &shipped : batch) {
+                const auto commit = serialization::deserialize_encoded_commit(shipped.bytes,
+                    this->component_registry);
+                apply_commit(this->replica, this->no_monitors, *commit);
+                this->replica_id = shipped.id;
+            }
+            const auto now = std::chrono::steady_clock::now();
+            std::shared_ptr<const std::string> bytes;
+            if (this->replica_id != this->snapshot_id && now - this->snapshot_time >= this->max_age) {
+                spdlog::debug("regenerating join snapshot at commit {}", this->replica_id);
+                bytes = std::make_shared<const std::string>(
+                    serialization::serialize_snapshot(this->replica, this->component_registry));
+            }
+
+            lock.lock();
+            if (bytes != nullptr) {
+                const auto covered = std::ranges::find_if(this->since,
+                                                          [this](const shipped_commit_t &shipped) {
+                                                              return shipped.id == this->replica_id;
+                                                          });
+                if (covered != this->since.end()) {
+                    this->since.erase(this->since.begin(), std::next(covered));
+                }
+                this->snapshot = std::move(bytes);
+                this->snapshot_id = this->replica_id;
+                this->snapshot_time = now;
+                this->snapshot_count++;
+            }
+        }
+    }
+
+public:
+    /**
+     * Writes the first snapshot on the calling thread.
+     * @param head Id of the last commit applied to reg, FIRST_BASE_ID if there is none
+     * @param max_age Age after which the snapshot is regenerated once new commits arrive
+     */
+    join_service_t(entt::registry &reg,
+                   const commit_id head,
+                   ComponentRegistry &component_registry,
+                   const std::chrono::steady_clock::duration max_age)
+        : component_registry(component_registry),
+          max_age(max_age),
+          replica_id(head),
+          snapshot_id(head),
+          snapshot(std::make_shared<const std::string>(
+              serialization::serialize_snapshot(reg, component_registry))),
+          snapshot_time(std::chrono::steady_clock::now()) {
+        this->replica.ctx().template emplace<static_entities_t>();
+        serialization::deserialize_snapshot(*this->snapshot, this->replica, component_registry);
+        this->worker = std::thread(&join_service_t::run, this);
+    }
+
+    join_service_t(const join_service_t &) = delete;
+
+    join_service_t &operator=(const join_service_t &) = delete;
+
+    ~join_service_t() {
+        {
+            std::lock_guard lock(this->mutex);
+            this->stopping = true;
+        }
+        this->wake.notify_one();
+        this->worker.join();
+    }
+
+    /**
+     * Hands an encoded commit to the service, in the order they are added to the history,
+     * e.g. from the thread polling a commit_pipeline_t. The bytes must not be compressed.
+     */
+    void publish(shipped_commit_t shipped) {
+        {
+            std::lock_guard lock(this->mutex);
+            this->queued.push_back(shipped);
+            this->since.push_back(std::move(shipped));
+        }
+        this->wake.notify_one();
+    }
+
+    /**
+     * publish for commits that do not go through a commit_pipeline_t. Encodes the commit on
+     * the calling thread unless its encoding is cached already.
+     */
+    void publish(const commit_id id, const commit_t &commit) {
+        this->publish(shipped_commit_t{id, commit.encoded()});
+    }
+
+    [[nodiscard]] join_state_t join() const {
+        std::lock_guard lock(this->mutex);
+        return {this->snapshot_id, this->snapshot, this->since};
+    }
+
+    /**
+     * Number of snapshots written so far, including the first one.
+     */
+    [[nodiscard]] size_t snapshots() const {
+        std::lock_guard lock(this->mutex);
+        return this->snapshot_count;
+    }
+};
+}
+
+#endif //ECS_HISTORY_JOIN_SERVICE_HPP
@@ -0,0 +1,135 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#ifndef ECS_HISTORY_MEMORY_HPP
+#define ECS_HISTORY_MEMORY_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#endif
+
+namespace ecs_history::memory {
+
+/**
+ * Returns the bytes an allocator occupies to serve a request of the given size.
+ */
+using allocation_size_t = size_t (*)(size_t bytes);
+
+/**
+ * Chunk sizes of ptmalloc (glibc): an 8 byte header, 16 byte alignment and a minimum chunk of 32 bytes.
+ */
+constexpr size_t ptmalloc_allocation_size(const size_t bytes) {
+    constexpr size_t header = sizeof(size_t);
+    constexpr size_t alignment = 2 * sizeof(size_t);
+    return std::max<size_t>((bytes + header + alignment - 1) & ~(alignment - 1), 32);
+}
+
+/**
+ * Size estimate of the allocator of the platform: ptmalloc on glibc, malloc_good_size on macOS,
+ * the requested bytes elsewhere.
+ */
+inline size_t platform_allocation_size(const size_t bytes) {
+#if defined(__GLIBC__)
+    return ptmalloc_allocation_size(bytes);
+#elif defined(__APPLE__)
+    return malloc_good_size(bytes);
+#else
+    return bytes;
+#endif
+}
+
+inline std::atomic<allocation_size_t> allocation_size{&platform_allocation_size};
+
+/**
+ * Sizes allocations like the allocator in use, e.g. with a wrapper of nallocx (jemalloc) or
+ * mi_good_size (mimalloc) when replacing malloc. The default is platform_allocation_size,
+ * nullptr counts the requested bytes.
+ */
+inline void set_allocation_size(const allocation_size_t size) {
+    allocation_size.store(size, std::memory_order_relaxed);
+}
+
+/**
+ * Bytes a heap allocation of the given size occupies, see set_allocation_size.
+ */
+inline size_t heap_block(const size_t bytes) {
+    if (bytes == 0) {
+        return 0;
+    }
+    const auto size = allocation_size.load(std::memory_order_relaxed);
+    return size == nullptr ? bytes : size(bytes);
+}
+
+/**
+ * Heap memory owned by a component value beyond sizeof(T).
+ * Specialize this for components holding buffers.
+ */
+template<typename T>
+struct heap_usage_t {
+    static size_t of(const T &) {
+        return 0;
+    }
+};
+
+template<typename Char, typename Traits, typename Allocator>
+struct heap_usage_t<std::basic_string<Char, Traits, Allocator> > {
+    static size_t of(const std::basic_string<Char, Traits, Allocator> &value) {
+        // Short strings are stored inline
+        if (value.capacity() < 16 / sizeof(Char)) {
+            return 0;
+        }
+        return heap_block((value.capacity() + 1) * sizeof(Char));
+    }
+};
+
+template<typename T, typename Allocator>
+struct heap_usage_t<std::vector<T, Allocator> > {
+    static size_t of(const std::vector<T, Allocator> &value) {
+        size_t bytes = heap_block(value.capacity() * sizeof(T));
+        for (const auto &element : value) {
+            bytes += heap_usage_t<T>::of(element);
+        }
+        return bytes;
+    }
+};
+
+template<typename T>
+size_t heap_usage(const T &value) {
+    return heap_usage_t<T>::of(value);
+}
+
+template<typename T, typename Allocator>
+size_t vector_bytes(const std::vector<T, Allocator> &vector) {
+    return heap_block(vector.capacity() * sizeof(T));
+}
+
+/**
+ * Bytes allocated by an unordered_map: the bucket array and one node per element.
+ */
+template<typename K, typename V, typename... Rest>
+size_t unordered_map_bytes(const std::unordered_map<K, V, Rest...> &map) {
+    const size_t buckets = map.bucket_count() > 1 ? heap_block(map.bucket_count() * sizeof(void *)) : 0;
+    return buckets + map.size() * heap_block(sizeof(void *) + sizeof(std::pair<const K, V>));
+}
+
+/**
+ * Bytes of one std::list node holding a T.
+ */
+template<typename T>
+size_t list_node_bytes() {
+    return heap_block(2 * sizeof(void *) + sizeof(T));
+}
+
+}
+
+#endif //ECS_HISTORY_MEMORY_HPP
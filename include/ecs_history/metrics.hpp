@@ -0,0 +1,396 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#ifndef ECS_HISTORY_METRICS_HPP
+#define ECS_HISTORY_METRICS_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <vector>
+#include <entt/core/fwd.hpp>
+
+namespace ecs_history {
+
+enum class stage_t : uint8_t {
+    CREATE_COMMIT = 0,
+    SERIALIZE = 1,
+    DESERIALIZE = 2,
+    APPLY = 3,
+    ROLLBACK = 4,
+    REBASE = 5,
+    COUNT = 6
+};
+
+/**
+ * Latency histogram with power of two buckets.
+ * Bucket i counts samples in [2^i, 2^(i+1)) nanoseconds.
+ */
+struct latency_histogram_t {
+    static constexpr size_t BUCKETS = 40;
+
+    std::array<uint64_t, BUCKETS> buckets{};
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+
+    [[nodiscard]] double mean_ns() const {
+        return count == 0 ? 0.0 : static_cast<double>(total_ns) / static_cast<double>(count);
+    }
+
+    /**
+     * Returns the upper bound of the bucket containing the given percentile (0 - 1).
+     */
+    [[nodiscard]] uint64_t percentile_ns(const double percentile) const {
+        const auto rank = static_cast<uint64_t>(percentile * static_cast<double>(count));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            seen += buckets[i];
+            if (seen > rank) {
+                return std::min<uint64_t>(max_ns, (uint64_t{1} << (i + 1)) - 1);
+            }
+        }
+        return max_ns;
+    }
+};
+
+struct component_metrics_t {
+    entt::id_type id;
+    uint64_t constructs;
+    uint64_t updates;
+    uint64_t destructs;
+};
+
+struct metrics_snapshot_t {
+    std::vector<component_metrics_t> components;
+
+    uint64_t commits = 0;
+    uint64_t commit_changes = 0;
+    uint64_t max_commit_changes = 0;
+
+    uint64_t serialized_commits = 0;
+    /**
+     * Encoded size of the serialized commits, as sent over the network
+     */
+    uint64_t serialized_bytes = 0;
+    uint64_t max_serialized_bytes = 0;
+    uint64_t deserialized_commits = 0;
+    uint64_t applied_commits = 0;
+    uint64_t applied_changes = 0;
+
+    uint64_t rollbacks = 0;
+    uint64_t rolled_back_commits = 0;
+    uint64_t max_rollback_depth = 0;
+    uint64_t rebased_commits = 0;
+    uint64_t max_rebase_depth = 0;
+    uint64_t dropped_commits = 0;
+    uint64_t rejected_commits = 0;
+
+    std::array<latency_histogram_t, static_cast<size_t>(stage_t::COUNT)> latencies{};
+
+    [[nodiscard]] const latency_histogram_t &latency(const stage_t stage) const {
+        return latencies[static_cast<size_t>(stage)];
+    }
+};
+
+template<bool Enabled = true>
+class metrics_t;
+
+template<typename Metrics>
+class scoped_timer_t {
+    Metrics &metrics;
+    stage_t stage;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    scoped_timer_t(Metrics &metrics, const stage_t stage)
+        : metrics(metrics),
+          stage(stage),
+          start(std::chrono::steady_clock::now()) {
+    }
+
+    scoped_timer_t(const scoped_timer_t &) = delete;
+
+    scoped_timer_t &operator=(const scoped_timer_t &) = delete;
+
+    ~scoped_timer_t() {
+        metrics.record_latency(stage, std::chrono::steady_clock::now() - start);
+    }
+};
+
+/**
+ * Lock-free metrics of the recording, commit and apply pipeline.
+ * All counters are relaxed atomics, so one instance can be shared between threads.
+ * Use metrics_t<false> (null_metrics_t) to compile all recording away.
+ */
+template<bool Enabled>
+class metrics_t {
+    static constexpr size_t COMPONENT_SLOTS = 64;
+
+    static void update_max(std::atomic<uint64_t> &max, const uint64_t value) {
+        uint64_t current = max.load(std::memory_order_relaxed);
+        while (current < value && !max.compare_exchange_weak(current,
+                                                             value,
+                                                             std::memory_order_relaxed)) {
+        }
+    }
+
+public:
+    static constexpr bool enabled = true;
+
+    struct component_counters_t {
+        std::atomic<entt::id_type> id{0};
+        std::atomic<uint64_t> constructs{0};
+        std::atomic<uint64_t> updates{0};
+        std::atomic<uint64_t> destructs{0};
+    };
+
+    /**
+     * Handle to the counters of one component, resolved once per monitor.
+     */
+    class component_handle_t {
+        component_counters_t *counters = nullptr;
+
+    public:
+        component_handle_t() = default;
+
+        explicit component_handle_t(component_counters_t *counters) : counters(counters) {
+        }
+
+        void record_construct() const {
+            if (counters != nullptr) {
+                counters->constructs.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        void record_update() const {
+            if (counters != nullptr) {
+                counters->updates.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        void record_destruct() const {
+            if (counters != nullptr) {
+                counters->destructs.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    struct histogram_counters_t {
+        std::array<std::atomic<uint64_t>, latency_histogram_t::BUCKETS> buckets{};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> total_ns{0};
+        std::atomic<uint64_t> max_ns{0};
+    };
+
+    metrics_t() = default;
+
+    metrics_t(const metrics_t &) = delete;
+
+    metrics_t &operator=(const metrics_t &) = delete;
+
+    /**
+     * Returns the counters of a component, claiming a free slot on first use.
+     * Returns an empty handle if all slots are taken.
+     */
+    [[nodiscard]] component_handle_t component(const entt::id_type id) {
+        const entt::id_type key = id == 0 ? 1 : id;
+        for (size_t i = 0; i < COMPONENT_SLOTS; ++i) {
+            auto &slot = components[(key + i) % COMPONENT_SLOTS];
+            entt::id_type expected = 0;
+            if (slot.id.compare_exchange_strong(expected, key, std::memory_order_relaxed)
+                || expected == key) {
+                return component_handle_t{&slot};
+            }
+        }
+        return component_handle_t{};
+    }
+
+    [[nodiscard]] scoped_timer_t<metrics_t> time(const stage_t stage) {
+        return scoped_timer_t<metrics_t>{*this, stage};
+    }
+
+    void record_latency(const stage_t stage, const std::chrono::nanoseconds duration) {
+        const auto ns = static_cast<uint64_t>(std::max<int64_t>(0, duration.count()));
+        auto &histogram = latencies[static_cast<size_t>(stage)];
+        const size_t bucket = std::min<size_t>(ns == 0 ? 0 : std::bit_width(ns) - 1,
+                                               latency_histogram_t::BUCKETS - 1);
+        histogram.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        histogram.count.fetch_add(1, std::memory_order_relaxed);
+        histogram.total_ns.fetch_add(ns, std::memory_order_relaxed);
+        update_max(histogram.max_ns, ns);
+    }
+
+    void record_commit(const uint64_t changes) {
+        commits.fetch_add(1, std::memory_order_relaxed);
+        commit_changes.fetch_add(changes, std::memory_order_relaxed);
+        update_max(max_commit_changes, changes);
+    }
+
+    void record_serialized(const uint64_t bytes) {
+        serialized_commits.fetch_add(1, std::memory_order_relaxed);
+        serialized_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        update_max(max_serialized_bytes, bytes);
+    }
+
+    void record_deserialized() {
+        deserialized_commits.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void record_applied(const uint64_t changes) {
+        applied_commits.fetch_add(1, std::memory_order_relaxed);
+        applied_changes.fetch_add(changes, std::memory_order_relaxed);
+    }
+
+    void record_rollback(const uint64_t depth) {
+        rollbacks.fetch_add(1, std::memory_order_relaxed);
+        rolled_back_commits.fetch_add(depth, std::memory_order_relaxed);
+        update_max(max_rollback_depth, depth);
+    }
+
+    void record_rebase(const uint64_t rebased, const uint64_t dropped) {
+        rebased_commits.fetch_add(rebased, std::memory_order_relaxed);
+        dropped_commits.fetch_add(dropped, std::memory_order_relaxed);
+        update_max(max_rebase_depth, rebased);
+    }
+
+    void record_rejected() {
+        rejected_commits.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] metrics_snapshot_t snapshot() const {
+        metrics_snapshot_t snapshot;
+        for (const auto &slot : components) {
+            if (const entt::id_type id = slot.id.load(std::memory_order_relaxed); id != 0) {
+                snapshot.components.push_back({id,
+                                               slot.constructs.load(std::memory_order_relaxed),
+                                               slot.updates.load(std::memory_order_relaxed),
+                                               slot.destructs.load(std::memory_order_relaxed)});
+            }
+        }
+        snapshot.commits = commits.load(std::memory_order_relaxed);
+        snapshot.commit_changes = commit_changes.load(std::memory_order_relaxed);
+        snapshot.max_commit_changes = max_commit_changes.load(std::memory_order_relaxed);
+        snapshot.serialized_commits = serialized_commits.load(std::memory_order_relaxed);
+        snapshot.serialized_bytes = serialized_bytes.load(std::memory_order_relaxed);
+        snapshot.max_serialized_bytes = max_serialized_bytes.load(std::memory_order_relaxed);
+        snapshot.deserialized_commits = deserialized_commits.load(std::memory_order_relaxed);
+        snapshot.applied_commits = applied_commits.load(std::memory_order_relaxed);
+        snapshot.applied_changes = applied_changes.load(std::memory_order_relaxed);
+        snapshot.rollbacks = rollbacks.load(std::memory_order_relaxed);
+        snapshot.rolled_back_commits = rolled_back_commits.load(std::memory_order_relaxed);
+        snapshot.max_rollback_depth = max_rollback_depth.load(std::memory_order_relaxed);
+        snapshot.rebased_commits = rebased_commits.load(std::memory_order_relaxed);
+        snapshot.max_rebase_depth = max_rebase_depth.load(std::memory_order_relaxed);
+        snapshot.dropped_commits = dropped_commits.load(std::memory_order_relaxed);
+        snapshot.rejected_commits = rejected_commits.load(std::memory_order_relaxed);
+        for (size_t stage = 0; stage < snapshot.latencies.size(); ++stage) {
+            const auto &counters = latencies[stage];
+            auto &histogram = snapshot.latencies[stage];
+            for (size_t i = 0; i < latency_histogram_t::BUCKETS; ++i) {
+                histogram.buckets[i] = counters.buckets[i].load(std::memory_order_relaxed);
+            }
+            histogram.count = counters.count.load(std::memory_order_relaxed);
+            histogram.total_ns = counters.total_ns.load(std::memory_order_relaxed);
+            histogram.max_ns = counters.max_ns.load(std::memory_order_relaxed);
+        }
+        return snapshot;
+    }
+
+private:
+    std::array<component_counters_t, COMPONENT_SLOTS> components{};
+
+    std::atomic<uint64_t> commits{0};
+    std::atomic<uint64_t> commit_changes{0};
+    std::atomic<uint64_t> max_commit_changes{0};
+
+    std::atomic<uint64_t> serialized_commits{0};
+    std::atomic<uint64_t> serialized_bytes{0};
+    std::atomic<uint64_t> max_serialized_bytes{0};
+    std::atomic<uint64_t> deserialized_commits{0};
+    std::atomic<uint64_t> applied_commits{0};
+    std::atomic<uint64_t> applied_changes{0};
+
+    std::atomic<uint64_t> rollbacks{0};
+    std::atomic<uint64_t> rolled_back_commits{0};
+    std::atomic<uint64_t> max_rollback_depth{0};
+    std::atomic<uint64_t> rebased_commits{0};
+    std::atomic<uint64_t> max_rebase_depth{0};
+    std::atomic<uint64_t> dropped_commits{0};
+    std::atomic<uint64_t> rejected_commits{0};
+
+    std::array<histogram_counters_t, static_cast<size_t>(stage_t::COUNT)> latencies{};
+};
+
+/**
+ * Disabled metrics. Every call is an empty inline function.
+ */
+template<>
+class metrics_t<false> {
+public:
+    static constexpr bool enabled = false;
+
+    struct component_handle_t {
+        void record_construct() const {
+        }
+
+        void record_update() const {
+        }
+
+        void record_destruct() const {
+        }
+    };
+
+    struct null_timer_t {
+    };
+
+    [[nodiscard]] component_handle_t component(entt::id_type) const {
+        return {};
+    }
+
+    [[nodiscard]] null_timer_t time(stage_t) const {
+        return {};
+    }
+
+    void record_latency(stage_t, std::chrono::nanoseconds) const {
+    }
+
+    void record_commit(uint64_t) const {
+    }
+
+    void record_serialized(uint64_t) const {
+    }
+
+    void record_deserialized() const {
+    }
+
+    void record_applied(uint64_t) const {
+    }
+
+    void record_rollback(uint64_t) const {
+    }
+
+    void record_rebase(uint64_t, uint64_t) const {
+    }
+
+    void record_rejected() const {
+    }
+
+    [[nodiscard]] metrics_snapshot_t snapshot() const {
+        return {};
+    }
+};
+
+using null_metrics_t = metrics_t<false>;
+
+inline null_metrics_t &null_metrics() {
+    static null_metrics_t metrics;
+    return metrics;
+}
+
+}
+
+#endif //ECS_HISTORY_METRICS_HPP
@@ -0,0 +1,93 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#ifndef ECS_HISTORY_PAYLOAD_HPP
+#define ECS_HISTORY_PAYLOAD_HPP
+
+#include <memory>
+#include <type_traits>
+
+#include "ecs_history/memory.hpp"
+
+namespace ecs_history {
+
+/**
+ * Specialize as std::true_type for components holding large buffers (meshes, inventories, ...).
+ * Their change records then share one immutable copy of each value: inverting a change,
+ * retaining it in a history and applying it never copy the value again.
+ */
+template<typename T>
+struct shared_payload_t : std::false_type {
+};
+
+template<typename T>
+constexpr bool shared_payload_v = shared_payload_t<T>::value;
+
+/**
+ * Component value held by a change record. Stored inline unless shared_payload_t is specialized.
+ */
+template<typename T, bool Shared = shared_payload_v<T> >
+class payload_t {
+    T value;
+
+public:
+    payload_t(const T &value) : value(value) {
+    }
+
+    payload_t(T &&value) : value(std::move(value)) {
+    }
+
+    [[nodiscard]] const T &get() const {
+        return this->value;
+    }
+
+    [[nodiscard]] size_t heap_usage() const {
+        return memory::heap_usage(this->value);
+    }
+};
+
+template<typename T>
+class payload_t<T, true> {
+    std::shared_ptr<const T> value;
+    // Copies share the value of the payload they were copied from
+    bool owner = true;
+
+public:
+    payload_t(const T &value) : value(std::make_shared<const T>(value)) {
+    }
+
+    payload_t(T &&value) : value(std::make_shared<const T>(std::move(value))) {
+    }
+
+    payload_t(const payload_t &other) : value(other.value), owner(false) {
+    }
+
+    payload_t(payload_t &&other) noexcept = default;
+
+    payload_t &operator=(const payload_t &other) {
+        this->value = other.value;
+        this->owner = false;
+        return *this;
+    }
+
+    payload_t &operator=(payload_t &&other) noexcept = default;
+
+    [[nodiscard]] const T &get() const {
+        return *this->value;
+    }
+
+    /**
+     * The value is counted by the payload it was created in, copies sharing it count nothing.
+     * Unlike dividing by the use count, this does not change when other records are freed.
+     */
+    [[nodiscard]] size_t heap_usage() const {
+        if (!this->owner) {
+            return 0;
+        }
+        return memory::heap_block(sizeof(T) + 2 * sizeof(long)) + memory::heap_usage(*this->value);
+    }
+};
+}
+
+#endif //ECS_HISTORY_PAYLOAD_HPP
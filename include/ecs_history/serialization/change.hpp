@@ -5,37 +5,42 @@
 #ifndef ECS_HISTORY_CHANGE_HPP
 #define ECS_HISTORY_CHANGE_HPP
 #include "ecs_history/change.hpp"
+#include "ecs_history/change_set.hpp"
 
 namespace ecs_history::serialization {
 
+/**
+ * Reads a change written without its entity.
+ */
 template<typename Archive, typename Type>
-std::unique_ptr<change_t<Type> > deserialize_change(Archive &archive) {
-    static_entity_t static_entity;
-    archive(static_entity);
+std::unique_ptr<change_t<Type> > deserialize_change_body(Archive &archive,
+                                                         const static_entity_t static_entity) {
     change_type_t change_type;
     archive(change_type);
     switch (change_type) {
     case change_type_t::CONSTRUCT: {
         Type value;
-        archive(value);
-        return std::make_unique<construct_change_t<Type> >(static_entity, value);
+        codec::load(archive, value);
+        return std::make_unique<construct_change_t<Type> >(static_entity, std::move(value));
     }
     case change_type_t::UPDATE: {
         Type old_value;
-        archive(old_value);
+        codec::load(archive, old_value);
         Type new_value;
-        archive(new_value);
-        return std::make_unique<update_change_t<Type> >(static_entity, old_value, new_value);
+        codec::load(archive, new_value);
+        return std::make_unique<update_change_t<Type> >(static_entity,
+                                                        std::move(old_value),
+                                                        std::move(new_value));
     }
     case change_type_t::UPDATE_ONLY_NEW: {
         Type new_value;
-        archive(new_value);
-        return std::make_unique<update_change_t<Type> >(static_entity, Type{}, new_value);
+        codec::load(archive, new_value);
+        return std::make_unique<update_change_t<Type> >(static_entity, Type{}, std::move(new_value));
     }
     case change_type_t::DESTRUCT: {
         Type old_value;
-        archive(old_value);
-        return std::make_unique<destruct_change_t<Type> >(static_entity, old_value);
+        codec::load(archive, old_value);
+        return std::make_unique<destruct_change_t<Type> >(static_entity, std::move(old_value));
     }
     case change_type_t::DESTRUCT_ONLY_NEW: {
         return std::make_unique<destruct_change_t<Type> >(static_entity, Type{});
@@ -44,6 +49,75 @@ std::unique_ptr<change_t<Type> > deserialize_change(Archive &archive) {
         throw std::runtime_error("Invalid change type while deserializing change");
     }
 }
+
+template<typename Archive, typename Type>
+std::unique_ptr<change_t<Type> > deserialize_change(Archive &archive) {
+    static_entity_t static_entity;
+    archive(static_entity);
+    return deserialize_change_body<Archive, Type>(archive, static_entity);
+}
+
+template<typename Archive, typename Type>
+std::unique_ptr<change_set_t<Type> > deserialize_change_set(Archive &archive) {
+    auto change_set = std::make_unique<change_set_t<Type> >();
+    uint32_t count;
+    archive(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        change_set->add_change(deserialize_change<Archive, Type>(archive));
+    }
+    return change_set;
+}
+
+/**
+ * Reads a change set whose entities are read by read_entity instead of from the archive.
+ */
+template<typename Archive, typename Type>
+std::unique_ptr<change_set_t<Type> > deserialize_change_set(Archive &archive,
+                                                            const entity_reader_t &read_entity) {
+    auto change_set = std::make_unique<change_set_t<Type> >();
+    uint32_t count;
+    archive(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        const static_entity_t static_entity = read_entity();
+        change_set->add_change(deserialize_change_body<Archive, Type>(archive, static_entity));
+    }
+    return change_set;
+}
+
+/**
+ * Reads a change set of constructions, as written by serialize_registry, straight into
+ * reg.storage<Type>(id). Values are inserted as one range instead of change by change.
+ */
+template<typename Archive, typename Type>
+void load_storage(Archive &archive, entt::registry &reg, const entt::id_type id) {
+    auto &static_entities = reg.ctx().get<static_entities_t>();
+    auto &storage = reg.storage<Type>(id);
+    uint32_t count;
+    archive(count);
+    std::vector<entt::entity> entities;
+    entities.reserve(count);
+    std::vector<Type> values;
+    values.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        static_entity_t static_entity;
+        archive(static_entity);
+        change_type_t change_type;
+        archive(change_type);
+        if (change_type != change_type_t::CONSTRUCT) {
+            throw std::runtime_error("Invalid change type while loading storage");
+        }
+        Type value;
+        codec::load(archive, value);
+        entities.push_back(static_entities.increase_ref(static_entity));
+        values.push_back(std::move(value));
+    }
+    storage.reserve(storage.size() + count);
+    if constexpr (entt::component_traits<Type>::page_size == 0u) {
+        storage.insert(entities.begin(), entities.end());
+    } else {
+        storage.insert(entities.begin(), entities.end(), values.begin());
+    }
+}
 }
 
 #endif //ECS_HISTORY_CHANGE_HPP
\ No newline at end of file
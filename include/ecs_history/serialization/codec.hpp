@@ -0,0 +1,350 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#ifndef ECS_HISTORY_CODEC_HPP
+#define ECS_HISTORY_CODEC_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include <cereal/cereal.hpp>
+
+namespace ecs_history {
+
+/**
+ * Selects the wire codec of a component in commits. Specialize it with a
+ * type member to encode a component with one of the codecs below instead of cereal:
+ *
+ * template<>
+ * struct ecs_history::codec_traits_t<position_t> {
+ *     using type = codec::struct_t<position_t,
+ *                                  codec::member_t<&position_t::x, codec::quantized_t<-512.f, 512.f, 16> >,
+ *                                  codec::member_t<&position_t::y, codec::half_t> >;
+ * };
+ *
+ * Codecs may be lossy, so the receiver of a commit may see slightly different values than the sender.
+ */
+template<typename T>
+struct codec_traits_t {
+};
+
+namespace codec {
+
+template<typename T>
+concept has_codec = requires { typename codec_traits_t<T>::type; };
+
+/**
+ * Writes values bit by bit, least significant bit first.
+ */
+class bit_writer_t {
+    uint8_t *data;
+    size_t bit = 0;
+
+public:
+    explicit bit_writer_t(uint8_t *data) : data(data) {
+    }
+
+    void write(uint64_t value, const unsigned bits) {
+        for (unsigned written = 0; written < bits;) {
+            const unsigned offset = this->bit % 8;
+            const unsigned count = std::min(8 - offset, bits - written);
+            const auto mask = static_cast<uint8_t>((1u << count) - 1);
+            this->data[this->bit / 8] |= static_cast<uint8_t>((value & mask) << offset);
+            value >>= count;
+            written += count;
+            this->bit += count;
+        }
+    }
+};
+
+class bit_reader_t {
+    const uint8_t *data;
+    size_t bit = 0;
+
+public:
+    explicit bit_reader_t(const uint8_t *data) : data(data) {
+    }
+
+    uint64_t read(const unsigned bits) {
+        uint64_t value = 0;
+        for (unsigned read = 0; read < bits;) {
+            const unsigned offset = this->bit % 8;
+            const unsigned count = std::min(8 - offset, bits - read);
+            const auto mask = static_cast<uint8_t>((1u << count) - 1);
+            value |= static_cast<uint64_t>((this->data[this->bit / 8] >> offset) & mask) << read;
+            read += count;
+            this->bit += count;
+        }
+        return value;
+    }
+};
+
+namespace detail {
+/**
+ * Computed in double, which holds every step of up to 32 bits exactly; float only holds 24.
+ * NaN is encoded as min.
+ */
+inline uint64_t quantize(const float value, const float min, const float max, const unsigned bits) {
+    const uint64_t steps = (uint64_t{1} << bits) - 1;
+    if (std::isnan(value)) {
+        return 0;
+    }
+    const double clamped = std::clamp<double>(value, min, max);
+    const double range = static_cast<double>(max) - static_cast<double>(min);
+    const auto step = std::llround((clamped - min) / range * static_cast<double>(steps));
+    return std::min(static_cast<uint64_t>(step), steps);
+}
+
+inline float dequantize(const uint64_t value, const float min, const float max, const unsigned bits) {
+    const uint64_t steps = (uint64_t{1} << bits) - 1;
+    const double range = static_cast<double>(max) - static_cast<double>(min);
+    return static_cast<float>(min + range * (static_cast<double>(value) / static_cast<double>(steps)));
+}
+
+/**
+ * Unsigned integer of the given size, for sizes without one the bytes in memory.
+ */
+template<size_t Size>
+using raw_bits_t = std::conditional_t<Size == 1, uint8_t,
+    std::conditional_t<Size == 2, uint16_t,
+        std::conditional_t<Size == 4, uint32_t,
+            std::conditional_t<Size == 8, uint64_t, std::array<uint8_t, Size> > > > >;
+}
+
+/**
+ * Stores a value unchanged.
+ */
+template<typename T>
+struct raw_t {
+    static_assert(std::is_trivially_copyable_v<T> && sizeof(T) <= sizeof(uint64_t));
+    static constexpr unsigned bits = sizeof(T) * 8;
+
+    static void encode(bit_writer_t &writer, const T &value) {
+        // Integers are widened by value, so the high bits stay zero on any byte order
+        const auto bits_of = std::bit_cast<detail::raw_bits_t<sizeof(T)> >(value);
+        uint64_t raw = 0;
+        if constexpr (std::is_integral_v<decltype(bits_of)>) {
+            raw = bits_of;
+        } else {
+            for (size_t i = 0; i < sizeof(T); ++i) {
+                raw |= uint64_t{bits_of[i]} << i * 8;
+            }
+        }
+        writer.write(raw, bits);
+    }
+
+    static T decode(bit_reader_t &reader) {
+        const uint64_t raw = reader.read(bits);
+        detail::raw_bits_t<sizeof(T)> bits_of{};
+        if constexpr (std::is_integral_v<decltype(bits_of)>) {
+            bits_of = static_cast<decltype(bits_of)>(raw);
+        } else {
+            for (size_t i = 0; i < sizeof(T); ++i) {
+                bits_of[i] = static_cast<uint8_t>(raw >> i * 8);
+            }
+        }
+        return std::bit_cast<T>(bits_of);
+    }
+};
+
+/**
+ * Maps a float in [Min, Max] to an integer of Bits bits. Values outside are clamped, NaN becomes Min.
+ */
+template<float Min, float Max, unsigned Bits>
+struct quantized_t {
+    static_assert(Min < Max);
+    static_assert(Bits > 0 && Bits <= 32);
+    static constexpr unsigned bits = Bits;
+
+    static void encode(bit_writer_t &writer, const float value) {
+        writer.write(detail::quantize(value, Min, Max, Bits), Bits);
+    }
+
+    static float decode(bit_reader_t &reader) {
+        return detail::dequantize(reader.read(Bits), Min, Max, Bits);
+    }
+};
+
+/**
+ * IEEE 754 half precision float.
+ */
+struct half_t {
+    static constexpr unsigned bits = 16;
+
+    static uint16_t to_half(const float value) {
+        const auto f = std::bit_cast<uint32_t>(value);
+        const uint32_t sign = f >> 16 & 0x8000;
+        const uint32_t exponent = f >> 23 & 0xff;
+        uint32_t mantissa = f & 0x7fffff;
+        if (exponent == 0xff) {
+            // Infinity and NaN
+            return static_cast<uint16_t>(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+        }
+        const int32_t half_exponent = static_cast<int32_t>(exponent) - 127 + 15;
+        if (half_exponent >= 0x1f) {
+            return static_cast<uint16_t>(sign | 0x7c00);
+        }
+        uint32_t shift = 13;
+        uint32_t half = static_cast<uint32_t>(std::max(half_exponent, 0)) << 10;
+        if (half_exponent <= 0) {
+            // Subnormal or zero
+            if (half_exponent < -10) {
+                return static_cast<uint16_t>(sign);
+            }
+            mantissa |= 0x800000;
+            shift = 14 - half_exponent;
+        }
+        half |= mantissa >> shift;
+        // Round to nearest even, a carry into the exponent is correct
+        const uint32_t rest = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1) != 0)) {
+            half++;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    static float from_half(const uint16_t half) {
+        const uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+        const uint32_t exponent = half >> 10 & 0x1f;
+        const uint32_t mantissa = half & 0x3ff;
+        if (exponent == 0x1f) {
+            return std::bit_cast<float>(sign | 0x7f800000 | mantissa << 13);
+        }
+        if (exponent == 0) {
+            const float value = std::ldexp(static_cast<float>(mantissa), -24);
+            return sign != 0 ? -value : value;
+        }
+        return std::bit_cast<float>(sign | (exponent + 112) << 23 | mantissa << 13);
+    }
+
+    static void encode(bit_writer_t &writer, const float value) {
+        writer.write(to_half(value), bits);
+    }
+
+    static float decode(bit_reader_t &reader) {
+        return from_half(static_cast<uint16_t>(reader.read(bits)));
+    }
+};
+
+/**
+ * Packs a unit quaternion with members x, y, z and w into the index of its largest
+ * component and the other three components with Bits bits each.
+ */
+template<typename Quaternion, unsigned Bits = 10>
+struct smallest_three_t {
+    static constexpr unsigned bits = 2 + 3 * Bits;
+    static constexpr float limit = 0.70710678f;
+
+    static void encode(bit_writer_t &writer, const Quaternion &value) {
+        const std::array<float, 4> components{value.x, value.y, value.z, value.w};
+        unsigned largest = 0;
+        for (unsigned i = 1; i < 4; ++i) {
+            if (std::abs(components[i]) > std::abs(components[largest])) {
+                largest = i;
+            }
+        }
+        // q and -q are the same rotation, so the largest component can always be positive
+        const float sign = components[largest] < 0 ? -1.f : 1.f;
+        writer.write(largest, 2);
+        for (unsigned i = 0; i < 4; ++i) {
+            if (i != largest) {
+                writer.write(detail::quantize(components[i] * sign, -limit, limit, Bits), Bits);
+            }
+        }
+    }
+
+    static Quaternion decode(bit_reader_t &reader) {
+        const auto largest = static_cast<unsigned>(reader.read(2));
+        std::array<float, 4> components{};
+        float sum = 0;
+        for (unsigned i = 0; i < 4; ++i) {
+            if (i != largest) {
+                components[i] = detail::dequantize(reader.read(Bits), -limit, limit, Bits);
+                sum += components[i] * components[i];
+            }
+        }
+        components[largest] = std::sqrt(std::max(0.f, 1.f - sum));
+        Quaternion value{};
+        value.x = components[0];
+        value.y = components[1];
+        value.z = components[2];
+        value.w = components[3];
+        return value;
+    }
+};
+
+/**
+ * Encodes one member of a struct with another codec.
+ */
+template<auto Member, typename Codec>
+struct member_t {
+    static constexpr unsigned bits = Codec::bits;
+
+    template<typename Struct>
+    static void encode(bit_writer_t &writer, const Struct &value) {
+        Codec::encode(writer, value.*Member);
+    }
+
+    template<typename Struct>
+    static void decode(bit_reader_t &reader, Struct &value) {
+        value.*Member = Codec::decode(reader);
+    }
+};
+
+/**
+ * Encodes a struct member by member. Members without a codec are value initialized on decode.
+ */
+template<typename T, typename... Members>
+struct struct_t {
+    static constexpr unsigned bits = (Members::bits + ...);
+
+    static void encode(bit_writer_t &writer, const T &value) {
+        (Members::encode(writer, value), ...);
+    }
+
+    static T decode(bit_reader_t &reader) {
+        T value{};
+        (Members::decode(reader, value), ...);
+        return value;
+    }
+};
+
+/**
+ * Writes a component value, using its codec if it has one.
+ */
+template<typename Archive, typename T>
+void save(Archive &archive, const T &value) {
+    if constexpr (has_codec<T>) {
+        using codec_type = typename codec_traits_t<T>::type;
+        std::array<uint8_t, (codec_type::bits + 7) / 8> bytes{};
+        bit_writer_t writer{bytes.data()};
+        codec_type::encode(writer, value);
+        archive(cereal::binary_data(bytes.data(), bytes.size()));
+    } else {
+        archive(value);
+    }
+}
+
+template<typename Archive, typename T>
+void load(Archive &archive, T &value) {
+    if constexpr (has_codec<T>) {
+        using codec_type = typename codec_traits_t<T>::type;
+        std::array<uint8_t, (codec_type::bits + 7) / 8> bytes{};
+        archive(cereal::binary_data(bytes.data(), bytes.size()));
+        bit_reader_t reader{bytes.data()};
+        value = codec_type::decode(reader);
+    } else {
+        archive(value);
+    }
+}
+}
+}
+
+#endif //ECS_HISTORY_CODEC_HPP
@@ -0,0 +1,71 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#ifndef ECS_HISTORY_INTEREST_HPP
+#define ECS_HISTORY_INTEREST_HPP
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "ecs_history/commit.hpp"
+
+namespace ecs_history::serialization {
+
+/**
+ * Selects the part of a commit a subscriber is interested in.
+ * A change is included if its component and its entity match.
+ */
+struct interest_filter_t {
+    /**
+     * Component ids to include. Empty includes all components.
+     */
+    std::unordered_set<entt::id_type> components;
+    /**
+     * Entities to include. nullopt includes all entities (unless there is a predicate).
+     */
+    std::optional<std::unordered_set<static_entity_t> > entities;
+    /**
+     * Checked after entities. Filters with a predicate are only shared by pointer.
+     */
+    std::function<bool(static_entity_t)> predicate;
+
+    [[nodiscard]] bool includes_component(const entt::id_type id) const {
+        return this->components.empty() || this->components.contains(id);
+    }
+
+    [[nodiscard]] bool includes_entity(const static_entity_t static_entity) const {
+        if (this->entities.has_value() && !this->entities->contains(static_entity)) {
+            return false;
+        }
+        return !this->predicate || this->predicate(static_entity);
+    }
+
+    /**
+     * True if both filters select the same changes for any commit.
+     */
+    [[nodiscard]] bool same_as(const interest_filter_t &other) const;
+};
+
+/**
+ * Serializes the view of a commit for every subscriber, in the format of serialize_commit.
+ *
+ * Changes are serialized once per commit and copied to every distinct filter that
+ * includes them. Subscribers sharing a filter object, or having equal filters without
+ * predicates, share the same buffer. Entity versions and destroyed entities are written for
+ * every entity the filter includes, whatever its component filter says, so versions of a
+ * subscriber stay in step with the sender. Destruct changes of destroyed entities are left
+ * out as in serialize_commit.
+ *
+ * @return One buffer per subscriber, in the order of subscribers
+ */
+std::vector<std::shared_ptr<const std::string> > serialize_filtered_commit(
+    const commit_t &commit,
+    const std::vector<std::shared_ptr<const interest_filter_t> > &subscribers);
+}
+
+#endif //ECS_HISTORY_INTEREST_HPP
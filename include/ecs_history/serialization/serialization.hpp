@@ -7,42 +7,47 @@
 #include "ecs_history/commit.hpp"
 #include "ecs_history/component/component_context.hpp"
 #include "ecs_history/static_entity.hpp"
+#include "ecs_history/tracing.hpp"
 #include <entt/entt.hpp>
+#include <algorithm>
+#include <bit>
+#include <istream>
+#include <optional>
+#include <string_view>
 
 namespace ecs_history::serialization {
 
-template<typename Archive>
+template<typename Archive, typename ComponentRegistry = registry::component_registry_t>
 void deserialize_registry(Archive &archive,
                           entt::registry &reg,
-                          registry::component_registry_t &component_registry) {
+                          ComponentRegistry &component_registry) {
     auto &static_entities = reg.ctx().get<static_entities_t>();
     uint32_t entities;
     archive(entities);
-    for (int i = 0; i < entities; ++i) {
-        static_entity_t static_entity;
-        archive(static_entity);
-        entity_version_t version;
-        archive(version);
-        static_entities.create(static_entity, version);
+    std::vector<static_entity_t> static_ids(entities);
+    std::vector<entity_version_t> versions(entities);
+    for (uint32_t i = 0; i < entities; ++i) {
+        archive(static_ids[i]);
+        archive(versions[i]);
     }
+    static_entities.create(static_ids, versions);
 
     uint16_t storage_count;
     archive(storage_count);
     for (int i = 0; i < storage_count; ++i) {
         entt::id_type id;
         archive(id);
-        const std::unique_ptr<base_change_set_t> change_set = component_registry.
-            deserialize_change_set(
-                id,
-                archive);
-        change_set->apply(reg, static_entities);
+        component_registry.load_storage(id, archive, reg);
+    }
+    if (static_entities.has_checksum_tracking()) {
+        recompute_checksums(reg, component_registry);
     }
 }
 
-template<typename Archive>
+template<typename Archive, typename ComponentRegistry = registry::component_registry_t>
 void serialize_registry(Archive &archive,
                         entt::registry &reg,
-                        registry::component_registry_t &component_registry) {
+                        ComponentRegistry &component_registry) {
     const auto &static_entities = reg.ctx().get<static_entities_t>();
 
     archive(static_cast<uint32_t>(static_entities.get_versions().size()));
@@ -67,8 +72,200 @@ void serialize_registry(Archive &archive,
     }
 }
 
+/**
+ * Writes the entities and storages that changed after since_epoch, so that loading it with
+ * deserialize_registry_incremental on top of the registry at since_epoch gives the current registry.
+ * Only storages changed after since_epoch are visited, and only components of changed entities are
+ * written. Requires epoch tracking in static_entities_t.
+ *
+ * Changes up to since_epoch are pruned afterwards, so the tracking stays proportional to the churn
+ * and later snapshots cannot start from an earlier epoch.
+ *
+ * @return The epoch to pass as since_epoch for the next incremental snapshot
+ */
+template<typename Archive, typename ComponentRegistry = registry::component_registry_t>
+uint64_t serialize_registry_incremental(Archive &archive,
+                                        entt::registry &reg,
+                                        ComponentRegistry &component_registry,
+                                        const uint64_t since_epoch) {
+    auto &static_entities = reg.ctx().get<static_entities_t>();
+    if (!static_entities.has_epoch_tracking()) {
+        throw std::runtime_error("Incremental snapshots require epoch tracking");
+    }
+    const uint64_t epoch = static_entities.advance_epoch();
+    archive(since_epoch);
+    archive(epoch);
+
+    const auto destroyed = static_entities.destroyed_entities(since_epoch);
+    archive(static_cast<uint32_t>(destroyed.size()));
+    for (const auto &static_entity : destroyed) {
+        archive(static_entity);
+    }
+
+    const auto changed = static_entities.changed_entities(since_epoch);
+    std::vector<entt::entity> changed_entities;
+    changed_entities.reserve(changed.size());
+    archive(static_cast<uint32_t>(changed.size()));
+    for (const auto &static_entity : changed) {
+        archive(static_entity);
+        archive(static_entities.get_version(static_entity));
+        changed_entities.push_back(static_entities.get_entity(static_entity));
+    }
+
+    std::vector<const entt::sparse_set *> storages;
+    for (auto [id, storage] : reg.storage()) {
+        if (static_entities.storage_epoch(storage.info().hash()) > since_epoch) {
+            storages.push_back(&storage);
+        }
+    }
+    archive(static_cast<uint16_t>(storages.size()));
+    for (const auto *storage : storages) {
+        const entt::id_type id = storage->info().hash();
+        archive(id);
+        const auto count = std::ranges::count_if(changed_entities,
+                                                 [storage](const entt::entity entt) {
+                                                     return storage->contains(entt);
+                                                 });
+        archive(static_cast<uint32_t>(count));
+        for (size_t i = 0; i < changed.size(); ++i) {
+            if (storage->contains(changed_entities[i])) {
+                archive(changed[i]);
+                archive(change_type_t::CONSTRUCT);
+                component_registry.serialize_raw(id, storage->value(changed_entities[i]), archive);
+            }
+        }
+    }
+    spdlog::debug("wrote incremental snapshot of {} entities and {} storages",
+                  changed.size(),
+                  storages.size());
+    static_entities.prune_epochs(since_epoch);
+    return epoch;
+}
+
+/**
+ * Layers an incremental snapshot on top of the registry. Incremental snapshots have to be
+ * loaded in the order they were written, starting from the snapshot they are based on.
+ */
+template<typename Archive, typename ComponentRegistry = registry::component_registry_t>
+void deserialize_registry_incremental(Archive &archive,
+                                      entt::registry &reg,
+                                      ComponentRegistry &component_registry) {
+    auto &static_entities = reg.ctx().get<static_entities_t>();
+    uint64_t since_epoch;
+    archive(since_epoch);
+    uint64_t epoch;
+    archive(epoch);
+
+    // Entities whose components are replaced
+    std::vector<static_entity_t> affected;
+    uint32_t destroyed_count;
+    archive(destroyed_count);
+    for (uint32_t i = 0; i < destroyed_count; ++i) {
+        static_entity_t static_entity;
+        archive(static_entity);
+        if (static_entities.has_entity(static_entity)) {
+            affected.push_back(static_entity);
+        }
+    }
+    uint32_t changed_count;
+    archive(changed_count);
+    for (uint32_t i = 0; i < changed_count; ++i) {
+        static_entity_t static_entity;
+        archive(static_entity);
+        entity_version_t version;
+        archive(version);
+        if (static_entities.has_entity(static_entity)) {
+            static_entities.set_version(static_entity, version);
+        } else {
+            static_entities.create(static_entity, version);
+        }
+        affected.push_back(static_entity);
+    }
+
+    // Hold a reference so entities survive losing all their components until they get new ones
+    static_entities.add_refs(affected, std::vector<uint16_t>(affected.size(), 1));
+
+    uint16_t storage_count;
+    archive(storage_count);
+    for (uint16_t i = 0; i < storage_count; ++i) {
+        entt::id_type id;
+        archive(id);
+        if (auto *storage = reg.storage(id); storage != nullptr) {
+            for (const auto &static_entity : affected) {
+                if (const auto entt = static_entities.get_entity(static_entity);
+                    storage->contains(entt)) {
+                    storage->remove(entt);
+                    static_entities.decrease_ref(static_entity);
+                }
+            }
+        }
+        component_registry.load_storage(id, archive, reg);
+    }
+
+    // Entities without components left are destroyed here
+    for (const auto &static_entity : affected) {
+        static_entities.decrease_ref(static_entity);
+    }
+    if (static_entities.has_checksum_tracking()) {
+        recompute_checksums(reg, component_registry);
+    }
+}
+
+template<typename Archive>
+void serialize_commit_checksums(Archive &archive, const commit_t &commit) {
+    archive(commit.checksum.has_value());
+    if (!commit.checksum.has_value()) {
+        return;
+    }
+    archive(*commit.checksum);
+    archive(static_cast<uint16_t>(commit.storage_checksums.size()));
+    for (const auto &[id, checksum] : commit.storage_checksums) {
+        archive(id);
+        archive(checksum);
+    }
+}
+
 template<typename Archive>
-void serialize_commit(Archive &archive, commit_t &commit) {
+void deserialize_commit_checksums(Archive &archive, commit_t &commit) {
+    bool has_checksum;
+    archive(has_checksum);
+    if (!has_checksum) {
+        return;
+    }
+    uint64_t checksum;
+    archive(checksum);
+    commit.checksum = checksum;
+    uint16_t count;
+    archive(count);
+    for (uint16_t i = 0; i < count; ++i) {
+        entt::id_type id;
+        archive(id);
+        archive(commit.storage_checksums[id]);
+    }
+}
+
+/**
+ * Indices of the changes written for a change set. Destruct changes of entities the commit
+ * destroys are left out, applying the commit removes those components anyway.
+ */
+inline std::vector<size_t> sent_changes(const commit_t &commit, const base_change_set_t &change_set) {
+    std::vector<size_t> sent;
+    const size_t count = change_set.count();
+    sent.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        if (!change_set.is_destruct(i) ||
+            !std::ranges::binary_search(commit.destroyed_entities, change_set.entity_at(i))) {
+            sent.push_back(i);
+        }
+    }
+    return sent;
+}
+
+/**
+ * Writes the commit change by change, ignoring its cached encoding.
+ */
+template<typename Archive>
+void encode_commit(Archive &archive, const commit_t &commit) {
     uint32_t entity_version_count = commit.entity_versions.size();
     archive(entity_version_count);
     for (const auto &[static_entity, version] : commit.entity_versions) {
@@ -79,10 +276,66 @@ void serialize_commit(Archive &archive, commit_t &commit) {
     archive(change_sets);
     for (const auto &change_set : commit.change_sets) {
         archive(change_set->id);
-        uint32_t count = change_set->count();
-        archive(count);
-        change_set->serialize(archive);
+        if (commit.destroyed_entities.empty()) {
+            uint32_t count = change_set->count();
+            archive(count);
+            change_set->serialize(archive);
+            continue;
+        }
+        const auto sent = sent_changes(commit, *change_set);
+        archive(static_cast<uint32_t>(sent.size()));
+        for (const size_t i : sent) {
+            change_set->serialize_change(i, archive);
+        }
     }
+    archive(static_cast<uint32_t>(commit.destroyed_entities.size()));
+    for (const auto static_entity : commit.destroyed_entities) {
+        archive(static_entity);
+    }
+    serialize_commit_checksums(archive, commit);
+}
+
+/**
+ * Writes the commit. Portable binary archives get a copy of the cached encoding of the byte
+ * order they write, which has to be passed as byte_order unless the archive was constructed
+ * with default options (native byte order). Returns the bytes written for them, other archives
+ * do not tell.
+ */
+template<typename Archive>
+std::optional<size_t> serialize_commit(Archive &archive,
+                                       const commit_t &commit,
+                                       const std::endian byte_order = std::endian::native) {
+    ECS_HISTORY_ZONE(zone, "serialize_commit");
+    ECS_HISTORY_ZONE_COUNT(zone, commit.count());
+    if constexpr (std::is_same_v<Archive, cereal::PortableBinaryOutputArchive>) {
+        const auto bytes = commit.encoded(byte_order);
+        ECS_HISTORY_ZONE_BYTES(zone, bytes->size());
+        // The first byte is the header of the archive that encoded the commit
+        archive(cereal::binary_data(bytes->data() + 1, bytes->size() - 1));
+        return bytes->size() - 1;
+    } else {
+        encode_commit(archive, commit);
+        return std::nullopt;
+    }
+}
+
+/**
+ * Records the bytes written where serialize_commit knows them, otherwise only the time.
+ */
+template<typename Archive, typename Metrics>
+std::optional<size_t> serialize_commit(Archive &archive,
+                                       const commit_t &commit,
+                                       Metrics &metrics,
+                                       const std::endian byte_order = std::endian::native) {
+    std::optional<size_t> written;
+    {
+        [[maybe_unused]] const auto timer = metrics.time(stage_t::SERIALIZE);
+        written = serialize_commit(archive, commit, byte_order);
+    }
+    if (written) {
+        metrics.record_serialized(*written);
+    }
+    return written;
 }
 
 template<typename Archive>
@@ -103,10 +356,10 @@ deserialize_commit_entity_versions(Archive &archive) {
 
 constexpr entt::id_type deserialize_change_set_func = entt::hashed_string{"deserialize_change_set"};
 
-template<typename Archive>
+template<typename Archive, typename ComponentRegistry = registry::component_registry_t>
 std::vector<std::unique_ptr<base_change_set_t> > deserialize_commit_changes(
     Archive &archive,
-    registry::component_registry_t &component_registry) {
+    ComponentRegistry &component_registry) {
     std::vector<std::unique_ptr<base_change_set_t> > change_sets;
     uint16_t change_set_count;
     archive(change_set_count);
@@ -118,14 +371,66 @@ std::vector<std::unique_ptr<base_change_set_t> > deserialize_commit_changes(
     return change_sets;
 }
 
-template<typename Archive>
+template<typename Archive, typename ComponentRegistry = registry::component_registry_t>
 std::unique_ptr<commit_t> deserialize_commit(Archive &archive,
-                                             registry::component_registry_t &component_registry) {
+                                             ComponentRegistry &component_registry) {
+    ECS_HISTORY_ZONE(zone, "deserialize_commit");
     auto entity_versions = serialization::deserialize_commit_entity_versions(archive);
     auto changes = serialization::deserialize_commit_changes(archive, component_registry);
-    return std::make_unique<commit_t>(
+    auto commit = std::make_unique<commit_t>(
         std::move(entity_versions),
         std::move(changes));
+    uint32_t destroyed_count;
+    archive(destroyed_count);
+    commit->destroyed_entities.resize(destroyed_count);
+    for (auto &static_entity : commit->destroyed_entities) {
+        archive(static_entity);
+    }
+    serialization::deserialize_commit_checksums(archive, *commit);
+    ECS_HISTORY_ZONE_COUNT(zone, commit->count());
+    return commit;
+}
+
+/**
+ * Read-only stream buffer over memory owned by someone else.
+ */
+class memory_streambuf_t final : public std::streambuf {
+public:
+    explicit memory_streambuf_t(const std::string_view bytes) {
+        char *data = const_cast<char *>(bytes.data());
+        this->setg(data, data, data + bytes.size());
+    }
+};
+
+/**
+ * Deserializes a commit written by serialize_commit into a fresh archive and keeps the bytes
+ * as its encoding, so forwarding the commit does not serialize it again.
+ */
+template<typename ComponentRegistry = registry::component_registry_t>
+std::unique_ptr<commit_t> deserialize_encoded_commit(std::shared_ptr<const std::string> bytes,
+                                                     ComponentRegistry &component_registry) {
+    memory_streambuf_t buffer{*bytes};
+    std::istream stream{&buffer};
+    std::unique_ptr<commit_t> commit;
+    {
+        cereal::PortableBinaryInputArchive archive(stream);
+        commit = deserialize_commit(archive, component_registry);
+    }
+    commit->set_encoded(std::move(bytes));
+    return commit;
+}
+
+template<typename Archive, typename ComponentRegistry, typename Metrics>
+std::unique_ptr<commit_t> deserialize_commit(Archive &archive,
+                                             ComponentRegistry &component_registry,
+                                             Metrics &metrics) {
+    std::unique_ptr<commit_t> commit;
+    {
+        [[maybe_unused]] const auto timer = metrics.time(stage_t::DESERIALIZE);
+        commit = deserialize_commit(archive, component_registry);
+    }
+    metrics.record_deserialized();
+    return commit;
 }
 }
 
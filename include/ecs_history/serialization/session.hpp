@@ -0,0 +1,137 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#ifndef ECS_HISTORY_SESSION_HPP
+#define ECS_HISTORY_SESSION_HPP
+
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "ecs_history/commit.hpp"
+#include "ecs_history/component/component_context.hpp"
+#include "ecs_history/serialization/serialization.hpp"
+
+namespace ecs_history::serialization {
+
+void write_varint(cereal::PortableBinaryOutputArchive &archive, uint32_t value);
+
+uint32_t read_varint(cereal::PortableBinaryInputArchive &archive);
+
+/**
+ * Session commit format
+ *
+ * releases:        varint count, count varint indices
+ * bindings:        varint count, per binding varint index and static entity
+ * entity versions: u32 count, per entity varint index and version
+ * change sets:     u16 count, per change set id, u32 count and per change varint index and body
+ * destroyed:       varint count, count varint indices
+ * checksums:       as in serialize_commit
+ *
+ * Released indices are freed before the bindings of the same commit are read, so they can be
+ * reused right away.
+ */
+
+/**
+ * Sending side of a per-connection entity dictionary.
+ *
+ * The first commit that references an entity binds its static id to a small session index,
+ * later commits only send the index. Indices are released when the entity was destroyed
+ * (if static_entities are passed to encode_commit) or when release is called, e.g. because
+ * the entity left the interest of the peer. Releases are sent with the next commit.
+ *
+ * Encoder and decoder only change in encode_commit and decode_commit, so they stay in sync as
+ * long as every encoded commit is decoded in the same order. Commits that a history rolls back
+ * do not undo bindings: undoing a commit is sent as another commit.
+ */
+class session_encoder_t {
+    std::unordered_map<static_entity_t, uint32_t> indices;
+    std::vector<uint32_t> free_indices;
+    std::vector<uint32_t> released;
+    uint32_t next_index = 0;
+
+    uint32_t bind(static_entity_t static_entity, std::vector<static_entity_t> &bindings);
+
+public:
+    /**
+     * Forgets the entity. Does nothing if it is not bound.
+     */
+    void release(static_entity_t static_entity);
+
+    [[nodiscard]] bool contains(const static_entity_t static_entity) const {
+        return this->indices.contains(static_entity);
+    }
+
+    [[nodiscard]] size_t size() const {
+        return this->indices.size();
+    }
+
+    /**
+     * Writes the commit in session format.
+     * @param static_entities Entities of the commit that no longer exist in it are released
+     */
+    void encode_commit(cereal::PortableBinaryOutputArchive &archive,
+                       const commit_t &commit,
+                       const static_entities_t *static_entities = nullptr);
+};
+
+/**
+ * Receiving side of a per-connection entity dictionary, see session_encoder_t.
+ */
+class session_decoder_t {
+    static constexpr static_entity_t UNBOUND = std::numeric_limits<static_entity_t>::max();
+
+    std::vector<static_entity_t> entities;
+
+    void read_dictionary(cereal::PortableBinaryInputArchive &archive);
+
+    static_entity_t read_entity(cereal::PortableBinaryInputArchive &archive) const;
+
+public:
+    [[nodiscard]] size_t size() const {
+        return std::ranges::count_if(this->entities,
+                                     [](const static_entity_t static_entity) {
+                                         return static_entity != UNBOUND;
+                                     });
+    }
+
+    template<typename ComponentRegistry = registry::component_registry_t>
+    std::unique_ptr<commit_t> decode_commit(cereal::PortableBinaryInputArchive &archive,
+                                            ComponentRegistry &component_registry) {
+        this->read_dictionary(archive);
+
+        std::unordered_map<static_entity_t, entity_version_t> entity_versions;
+        uint32_t entity_version_count;
+        archive(entity_version_count);
+        for (uint32_t i = 0; i < entity_version_count; ++i) {
+            const static_entity_t static_entity = this->read_entity(archive);
+            entity_version_t version;
+            archive(version);
+            entity_versions[static_entity] = version;
+        }
+
+        const entity_reader_t read_entity = [this, &archive] {
+            return this->read_entity(archive);
+        };
+        std::vector<std::unique_ptr<base_change_set_t> > change_sets;
+        uint16_t change_set_count;
+        archive(change_set_count);
+        for (uint16_t i = 0; i < change_set_count; ++i) {
+            entt::id_type id;
+            archive(id);
+            change_sets.push_back(component_registry.deserialize_change_set(id, archive, read_entity));
+        }
+        auto commit = std::make_unique<commit_t>(std::move(entity_versions), std::move(change_sets));
+        commit->destroyed_entities.resize(read_varint(archive));
+        for (auto &static_entity : commit->destroyed_entities) {
+            static_entity = this->read_entity(archive);
+        }
+        deserialize_commit_checksums(archive, *commit);
+        return commit;
+    }
+};
+}
+
+#endif //ECS_HISTORY_SESSION_HPP
@@ -0,0 +1,313 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#ifndef ECS_HISTORY_SNAPSHOT_HPP
+#define ECS_HISTORY_SNAPSHOT_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <future>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+#include "ecs_history/serialization/serialization.hpp"
+
+namespace ecs_history::serialization {
+
+/**
+ * Snapshot format v2
+ *
+ * header:       u32 magic, u16 version, u8 flags, u8 reserved
+ * entity table: u32 count, count static ids, count versions
+ * chunk table:  u16 count, per chunk u32 component id, u32 storage id, u64 offset, u64 size
+ * chunks:       one per storage, offsets are relative to the first chunk
+ *
+ * A chunk is u32 count, count u32 indices into the entity table and the values.
+ * Values of components with snapshot_raw_copy_t are stored as they are in memory, all others
+ * through a PortableBinaryOutputArchive. Everything outside of archives uses the byte order of
+ * the writer, which is stored in the flags.
+ */
+constexpr uint32_t SNAPSHOT_MAGIC = 0x48534345;
+constexpr uint16_t SNAPSHOT_VERSION = 2;
+constexpr uint8_t SNAPSHOT_BIG_ENDIAN = 1;
+
+/**
+ * True for components whose values are copied into snapshots as they are in memory.
+ * Copying padding would make snapshots of equal registries differ, so this defaults to types
+ * without padding bytes. Specialize as std::true_type for trivially copyable components
+ * without padding that the default misses, e.g. structs of floats.
+ */
+template<typename T>
+struct snapshot_raw_copy_t : std::bool_constant<std::has_unique_object_representations_v<T> ||
+                                                std::is_same_v<T, float> ||
+                                                std::is_same_v<T, double> > {
+};
+
+template<typename T>
+constexpr bool snapshot_raw_copy_v = snapshot_raw_copy_t<T>::value;
+
+namespace detail {
+template<typename T>
+void append(std::string &out, const T &value) {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template<typename T>
+T read(std::string_view &in) {
+    if (in.size() < sizeof(T)) {
+        throw std::runtime_error("Snapshot is truncated");
+    }
+    T value;
+    std::memcpy(&value, in.data(), sizeof(T));
+    in.remove_prefix(sizeof(T));
+    return value;
+}
+
+template<typename T>
+void read_column(std::string_view &in, std::vector<T> &column) {
+    const size_t bytes = column.size() * sizeof(T);
+    if (in.size() < bytes) {
+        throw std::runtime_error("Snapshot is truncated");
+    }
+    std::memcpy(column.data(), in.data(), bytes);
+    in.remove_prefix(bytes);
+}
+
+template<typename T>
+constexpr bool stores_values = entt::component_traits<T>::page_size != 0u;
+
+template<typename T>
+constexpr bool copies_values = [] {
+    if constexpr (stores_values<T> && snapshot_raw_copy_v<T>) {
+        static_assert(std::is_trivially_copyable_v<T>,
+                      "snapshot_raw_copy_t requires a trivially copyable component");
+        return true;
+    } else {
+        return false;
+    }
+}();
+
+constexpr uint8_t native_flags() {
+    return std::endian::native == std::endian::big ? SNAPSHOT_BIG_ENDIAN : 0;
+}
+}
+
+/**
+ * Encodes one storage as a snapshot chunk.
+ */
+template<typename T>
+std::string encode_storage(const entt::sparse_set &base, const static_entities_t &static_entities) {
+    const auto &storage = static_cast<const entt::storage_type_t<T> &>(base);
+    const auto count = static_cast<uint32_t>(storage.size());
+    constexpr size_t value_size = detail::copies_values<T> ? sizeof(T) : 0;
+
+    std::string chunk;
+    chunk.resize(sizeof(uint32_t) + count * (sizeof(uint32_t) + value_size));
+    std::memcpy(chunk.data(), &count, sizeof(uint32_t));
+    char *indices = chunk.data() + sizeof(uint32_t);
+    char *values = indices + count * sizeof(uint32_t);
+
+    std::ostringstream stream;
+    cereal::PortableBinaryOutputArchive archive(stream);
+    for (auto element : storage.each()) {
+        const auto index = static_cast<uint32_t>(static_entities.index_of(std::get<0>(element)));
+        std::memcpy(indices, &index, sizeof(uint32_t));
+        indices += sizeof(uint32_t);
+        if constexpr (value_size != 0) {
+            std::memcpy(values, &std::get<1>(element), value_size);
+            values += value_size;
+        } else if constexpr (detail::stores_values<T>) {
+            archive(std::get<1>(element));
+        }
+    }
+    if constexpr (value_size == 0 && detail::stores_values<T>) {
+        chunk += stream.view();
+    }
+    return chunk;
+}
+
+/**
+ * Decodes a chunk written by encode_storage into reg.storage<T>(storage_id).
+ * entities maps entity table indices to entities, refs counts the components added to each.
+ */
+template<typename T>
+void decode_storage(std::string_view chunk,
+                    entt::registry &reg,
+                    const entt::id_type storage_id,
+                    const std::vector<entt::entity> &entities,
+                    std::vector<uint16_t> &refs) {
+    auto &storage = reg.storage<T>(storage_id);
+    const auto count = detail::read<uint32_t>(chunk);
+    std::vector<uint32_t> indices(count);
+    detail::read_column(chunk, indices);
+
+    std::vector<entt::entity> targets(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (indices[i] >= entities.size()) {
+            throw std::runtime_error("Snapshot references unknown entity");
+        }
+        targets[i] = entities[indices[i]];
+        refs[indices[i]]++;
+    }
+    storage.reserve(storage.size() + count);
+
+    if constexpr (!detail::stores_values<T>) {
+        storage.insert(targets.begin(), targets.end());
+    } else if constexpr (detail::copies_values<T>) {
+        std::vector<T> values(count);
+        detail::read_column(chunk, values);
+        storage.insert(targets.begin(), targets.end(), values.begin());
+    } else {
+        memory_streambuf_t buffer{chunk};
+        std::istream stream{&buffer};
+        cereal::PortableBinaryInputArchive archive(stream);
+        std::vector<T> values(count);
+        for (auto &value : values) {
+            archive(value);
+        }
+        storage.insert(targets.begin(), targets.end(), values.begin());
+    }
+}
+
+/**
+ * Writes the registry in snapshot format v2. Storages are encoded in parallel, on at most
+ * std::thread::hardware_concurrency threads including the calling one.
+ */
+template<typename ComponentRegistry = registry::component_registry_t>
+std::string serialize_snapshot(entt::registry &reg, const ComponentRegistry &component_registry) {
+    const auto &static_entities = reg.ctx().get<static_entities_t>();
+
+    struct chunk_t {
+        entt::id_type component_id;
+        entt::id_type storage_id;
+        const entt::sparse_set *source;
+    };
+    std::vector<chunk_t> chunks;
+    for (auto [id, storage] : reg.storage()) {
+        chunks.push_back({storage.info().hash(), id, &storage});
+    }
+
+    // Workers take the next storage until none is left, so large storages do not hold up others
+    std::vector<std::string> encoded(chunks.size());
+    std::atomic<size_t> next{0};
+    const auto encode = [&] {
+        for (size_t i = next++; i < chunks.size(); i = next++) {
+            encoded[i] = component_registry.serialize_storage(chunks[i].component_id,
+                                                              *chunks[i].source,
+                                                              static_entities);
+        }
+    };
+    const size_t threads = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u),
+                                            chunks.size());
+    std::vector<std::future<void> > workers;
+    for (size_t i = 1; i < threads; ++i) {
+        workers.push_back(std::async(std::launch::async, encode));
+    }
+    encode();
+    for (auto &worker : workers) {
+        worker.get();
+    }
+
+    std::string snapshot;
+    detail::append(snapshot, SNAPSHOT_MAGIC);
+    detail::append(snapshot, SNAPSHOT_VERSION);
+    detail::append(snapshot, detail::native_flags());
+    detail::append(snapshot, uint8_t{0});
+
+    const auto entity_count = static_cast<uint32_t>(static_entities.size());
+    detail::append(snapshot, entity_count);
+    std::vector<static_entity_t> static_ids(entity_count);
+    std::vector<entity_version_t> versions(entity_count);
+    for (uint32_t i = 0; i < entity_count; ++i) {
+        static_ids[i] = static_entities.get_static_entity(static_entities.entity_at(i));
+        versions[i] = static_entities.get_version(static_ids[i]);
+    }
+    snapshot.append(reinterpret_cast<const char *>(static_ids.data()),
+                    static_ids.size() * sizeof(static_entity_t));
+    snapshot.append(reinterpret_cast<const char *>(versions.data()),
+                    versions.size() * sizeof(entity_version_t));
+
+    detail::append(snapshot, static_cast<uint16_t>(chunks.size()));
+    uint64_t offset = 0;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        detail::append(snapshot, chunks[i].component_id);
+        detail::append(snapshot, chunks[i].storage_id);
+        detail::append(snapshot, offset);
+        detail::append(snapshot, static_cast<uint64_t>(encoded[i].size()));
+        offset += encoded[i].size();
+    }
+    snapshot.reserve(snapshot.size() + offset);
+    for (const auto &chunk : encoded) {
+        snapshot += chunk;
+    }
+    return snapshot;
+}
+
+/**
+ * Loads a snapshot written by serialize_snapshot into an empty registry.
+ * Entities are created in bulk, values are inserted as ranges and reference counts
+ * are set once per entity after all storages were loaded.
+ */
+template<typename ComponentRegistry = registry::component_registry_t>
+void deserialize_snapshot(std::string_view snapshot,
+                          entt::registry &reg,
+                          ComponentRegistry &component_registry) {
+    auto &static_entities = reg.ctx().get<static_entities_t>();
+    if (detail::read<uint32_t>(snapshot) != SNAPSHOT_MAGIC) {
+        throw std::runtime_error("Data is not a snapshot");
+    }
+    if (detail::read<uint16_t>(snapshot) != SNAPSHOT_VERSION) {
+        throw std::runtime_error("Unsupported snapshot version");
+    }
+    if (detail::read<uint8_t>(snapshot) != detail::native_flags()) {
+        throw std::runtime_error("Snapshot was written with a different byte order");
+    }
+    detail::read<uint8_t>(snapshot);
+
+    const auto entity_count = detail::read<uint32_t>(snapshot);
+    std::vector<static_entity_t> static_ids(entity_count);
+    std::vector<entity_version_t> versions(entity_count);
+    detail::read_column(snapshot, static_ids);
+    detail::read_column(snapshot, versions);
+    const std::vector<entt::entity> entities = static_entities.create(static_ids, versions);
+    std::vector<uint16_t> refs(entity_count, 0);
+
+    const auto chunk_count = detail::read<uint16_t>(snapshot);
+    struct chunk_t {
+        entt::id_type component_id;
+        entt::id_type storage_id;
+        uint64_t offset;
+        uint64_t size;
+    };
+    std::vector<chunk_t> chunks(chunk_count);
+    for (auto &chunk : chunks) {
+        chunk.component_id = detail::read<entt::id_type>(snapshot);
+        chunk.storage_id = detail::read<entt::id_type>(snapshot);
+        chunk.offset = detail::read<uint64_t>(snapshot);
+        chunk.size = detail::read<uint64_t>(snapshot);
+    }
+    for (const auto &chunk : chunks) {
+        if (chunk.offset + chunk.size > snapshot.size()) {
+            throw std::runtime_error("Snapshot is truncated");
+        }
+        component_registry.deserialize_storage(chunk.component_id,
+                                               snapshot.substr(chunk.offset, chunk.size),
+                                               reg,
+                                               chunk.storage_id,
+                                               entities,
+                                               refs);
+    }
+    static_entities.add_refs(static_ids, refs);
+    if (static_entities.has_checksum_tracking()) {
+        recompute_checksums(reg, component_registry);
+    }
+}
+}
+
+#endif //ECS_HISTORY_SNAPSHOT_HPP
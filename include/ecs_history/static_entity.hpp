@@ -5,7 +5,9 @@
 #ifndef ECS_HISTORY_STATIC_ENTITY_HPP
 #define ECS_HISTORY_STATIC_ENTITY_HPP
 #include <cstdint>
+#include <map>
 #include <random>
+#include <vector>
 #include <entt/entity/registry.hpp>
 #include <entt/entity/storage.hpp>
 
@@ -40,15 +42,50 @@ class static_entities_t {
     std::unordered_map<static_entity_t, entity_container> entities;
     entt::storage<static_entity_container_t> static_entities;
     std::unordered_map<static_entity_t, entity_version_t> versions;
+    std::unordered_map<static_entity_t, entity_version_t> pending_versions;
+    bool eager_versions = false;
+    uint64_t epoch = 1;
+    bool epoch_tracking = false;
+    std::unordered_map<entt::id_type, uint64_t> storage_epochs;
+    // Last epoch in which an entity changed or was destroyed, kept until the epoch is pruned
+    std::unordered_map<static_entity_t, uint64_t> entity_epochs;
+    std::unordered_map<static_entity_t, uint64_t> destroyed_epochs;
+    // Entities by the epoch they changed or were destroyed in, so queries only visit later epochs
+    std::map<uint64_t, std::vector<static_entity_t> > changed_by_epoch;
+    std::map<uint64_t, std::vector<static_entity_t> > destroyed_by_epoch;
+    std::unordered_map<static_entity_t, entity_version_t> destroyed_by_changes;
+    std::vector<static_entity_t> deferred_releases;
+    bool checksum_tracking = false;
+    std::unordered_map<entt::id_type, uint64_t> storage_checksums;
+    uint64_t total_checksum = 0;
     static_entity_t next;
 
+    void erase(static_entity_t static_entity);
+
+    void add_changed(static_entity_t static_entity);
+
 public:
     explicit static_entities_t() : next(random_entity_start()) {
     }
 
     entt::entity create();
 
-    void create(static_entity_t static_entity, entity_version_t version);
+    entt::entity create(static_entity_t static_entity, entity_version_t version);
+
+    /**
+     * Creates entities in bulk, e.g. when loading a snapshot. The returned entities are in the
+     * order of static_ids and have no references yet, see add_refs.
+     */
+    std::vector<entt::entity> create(const std::vector<static_entity_t> &static_ids,
+                                     const std::vector<entity_version_t> &versions);
+
+    /**
+     * Adds refs[i] references to static_ids[i].
+     */
+    void add_refs(const std::vector<static_entity_t> &static_ids,
+                  const std::vector<uint16_t> &refs);
+
+    void reserve(size_t count);
 
     bool has_entity(static_entity_t static_entity) const;
 
@@ -58,6 +95,35 @@ public:
 
     entt::entity decrease_ref(static_entity_t static_entity);
 
+    /**
+     * Destroys an entity independent of its reference count. Its components have to be removed already.
+     */
+    void destroy(static_entity_t static_entity);
+
+    /**
+     * decrease_ref for recorded changes. Remembers the entity and its version before the
+     * current commit if this destroys it.
+     */
+    entt::entity release(static_entity_t static_entity);
+
+    /**
+     * release at the end of the next create_commit, once all monitors added their references.
+     */
+    void defer_release(const static_entity_t static_entity) {
+        this->deferred_releases.push_back(static_entity);
+    }
+
+    /**
+     * Releases the references passed to defer_release.
+     */
+    void release_deferred();
+
+    /**
+     * Returns the entities destroyed by recorded changes since the last call that do not exist
+     * again, with their versions before the commit.
+     */
+    std::unordered_map<static_entity_t, entity_version_t> take_destroyed_entities();
+
     [[nodiscard]] static_entity_t get_static_entity(entt::entity entt) const;
 
     [[nodiscard]] entt::entity get_entity(static_entity_t static_entity) const;
@@ -68,9 +134,136 @@ public:
 
     entity_version_t increment_version(static_entity_t entity);
 
+    /**
+     * In eager versioning mode entity versions are incremented when a monitor records the
+     * first change of an entity since the last commit instead of when the commit is created.
+     * create_commit then only has to take the pending versions, independent of the commit size.
+     */
+    void set_eager_versions(bool eager);
+
+    [[nodiscard]] bool has_eager_versions() const {
+        return this->eager_versions;
+    }
+
+    /**
+     * Called by monitors for every recorded change.
+     */
+    void touch(const static_entity_t static_entity) {
+        if (this->eager_versions && !this->pending_versions.contains(static_entity)) {
+            this->pending_versions.emplace(static_entity, this->increment_version(static_entity));
+        }
+        this->mark_entity_changed(static_entity);
+    }
+
+    /**
+     * Changes are tagged with the current epoch. Returns the epoch that just ended:
+     * every change made so far has an epoch less than or equal to it.
+     */
+    uint64_t advance_epoch() {
+        return this->epoch++;
+    }
+
+    [[nodiscard]] uint64_t current_epoch() const {
+        return this->epoch;
+    }
+
+    void mark_storage_changed(const entt::id_type id) {
+        this->storage_epochs[id] = this->epoch;
+    }
+
+    /**
+     * Returns the epoch of the last change of a storage, 0 if it never changed.
+     */
+    [[nodiscard]] uint64_t storage_epoch(entt::id_type id) const;
+
+    /**
+     * Per entity epochs cost a hash map update for every change, so they have to be enabled.
+     * Entities changed before they were enabled are not tracked.
+     */
+    void set_epoch_tracking(bool tracking);
+
+    [[nodiscard]] bool has_epoch_tracking() const {
+        return this->epoch_tracking;
+    }
+
+    void mark_entity_changed(const static_entity_t static_entity) {
+        if (this->epoch_tracking) {
+            this->add_changed(static_entity);
+        }
+    }
+
+    /**
+     * Returns the existing entities that were created or changed after the given epoch.
+     * Only visits the entities changed after it, not all entities.
+     */
+    [[nodiscard]] std::vector<static_entity_t> changed_entities(uint64_t since_epoch) const;
+
+    /**
+     * Returns the entities that were destroyed after the given epoch.
+     */
+    [[nodiscard]] std::vector<static_entity_t> destroyed_entities(uint64_t since_epoch) const;
+
+    /**
+     * Forgets entities changed or destroyed up to the given epoch, so changed_entities and
+     * destroyed_entities no longer return them for earlier epochs.
+     */
+    void prune_epochs(uint64_t until_epoch);
+
+    /**
+     * Registry checksums are the sum of checksum_of(static entity, value) over all components
+     * of a storage. Monitors and change_applier_t keep them up to date while enabled. Storages
+     * loaded in bulk or changed before tracking was enabled need recompute_checksums.
+     */
+    void set_checksum_tracking(bool tracking);
+
+    [[nodiscard]] bool has_checksum_tracking() const {
+        return this->checksum_tracking;
+    }
+
+    void update_checksum(const entt::id_type id, const uint64_t removed, const uint64_t added) {
+        this->storage_checksums[id] += added - removed;
+        this->total_checksum += added - removed;
+    }
+
+    void set_storage_checksum(entt::id_type id, uint64_t checksum);
+
+    /**
+     * Sum of all storage checksums.
+     */
+    [[nodiscard]] uint64_t checksum() const {
+        return this->total_checksum;
+    }
+
+    [[nodiscard]] uint64_t storage_checksum(entt::id_type id) const;
+
+    [[nodiscard]] const std::unordered_map<entt::id_type, uint64_t> &get_storage_checksums() const {
+        return this->storage_checksums;
+    }
+
+    /**
+     * Returns the versions of all entities touched since the last call.
+     */
+    std::unordered_map<static_entity_t, entity_version_t> take_pending_versions();
+
     const std::unordered_map<static_entity_t, entity_version_t> &get_versions() const {
         return this->versions;
     }
+
+    /**
+     * Number of entities. Together with entity_at and index_of this gives every entity a dense
+     * index, which stays valid until an entity is created or destroyed.
+     */
+    [[nodiscard]] size_t size() const {
+        return this->static_entities.size();
+    }
+
+    [[nodiscard]] entt::entity entity_at(const size_t index) const {
+        return this->static_entities.data()[index];
+    }
+
+    [[nodiscard]] size_t index_of(const entt::entity entt) const {
+        return this->static_entities.index(entt);
+    }
 };
 }
 
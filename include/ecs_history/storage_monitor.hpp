@@ -8,6 +8,9 @@
 #include "ecs_history/change.hpp"
 #include "ecs_history/static_entity.hpp"
 #include "ecs_history/change_set.hpp"
+#include "ecs_history/metrics.hpp"
+#include "ecs_history/tracing.hpp"
+#include "ecs_history/update_filter.hpp"
 
 namespace ecs_history {
 class base_storage_monitor_t {
@@ -25,22 +28,62 @@ public:
 
     virtual void clear() = 0;
 
+    /**
+     * Removes the components of the given entities without recording them or changing
+     * reference counts, and returns their destruct changes. Only called while disabled.
+     */
+    virtual std::unique_ptr<base_change_set_t> remove_entities(
+        const std::vector<static_entity_t> &removed) = 0;
+
     virtual ~base_storage_monitor_t() = default;
 };
 
 template<typename T>
+std::unique_ptr<base_change_set_t> remove_entities(entt::storage_type_t<T> &storage,
+                                                  static_entities_t &entities,
+                                                  const entt::id_type id,
+                                                  const std::vector<static_entity_t> &removed) {
+    auto change_set = std::make_unique<change_set_t<T> >(id);
+    for (const auto static_entity : removed) {
+        const auto entt = entities.get_entity(static_entity);
+        if (!storage.contains(entt)) {
+            continue;
+        }
+        std::unique_ptr<destruct_change_t<T> > change;
+        if constexpr (entt::component_traits<T>::page_size == 0u) {
+            change = std::make_unique<destruct_change_t<T> >(static_entity, T{});
+        } else {
+            change = std::make_unique<destruct_change_t<T> >(static_entity, storage.get(entt));
+        }
+        track_checksum<T>(entities, id, static_entity, &change->old_value.get(), nullptr);
+        storage.remove(entt);
+        change_set->add_change(std::move(change));
+    }
+    return change_set;
+}
+
+template<typename T, typename Metrics = null_metrics_t>
 class storage_monitor_t final : public base_storage_monitor_t {
 
 public:
     explicit storage_monitor_t(static_entities_t &entities,
-                               entt::storage_type_t<T> &storage)
+                               entt::storage_type_t<T> &storage) requires (!Metrics::enabled)
+        : storage_monitor_t(entities, storage, null_metrics()) {
+    }
+
+    explicit storage_monitor_t(static_entities_t &entities,
+                               entt::storage_type_t<T> &storage,
+                               Metrics &metrics)
         : base_storage_monitor_t(storage.info().hash()),
           entities(entities),
-          storage(storage) {
+          storage(storage),
+          counters(metrics.component(storage.info().hash())) {
         this->enable();
     }
 
     std::unique_ptr<base_change_set_t> commit() override {
+        ECS_HISTORY_ZONE(zone, "monitor commit");
+        ECS_HISTORY_ZONE_COUNT(zone, this->changes.size());
         std::unique_ptr<base_change_set_t> change_set = std::make_unique<change_set_t<T> >(
             this->changes,
             this->id);
@@ -51,6 +94,11 @@ public:
         this->changes.clear();
     }
 
+    std::unique_ptr<base_change_set_t> remove_entities(
+        const std::vector<static_entity_t> &removed) override {
+        return ecs_history::remove_entities<T>(this->storage, this->entities, this->id, removed);
+    }
+
     void enable() override {
         this->storage.on_construct().template connect<&storage_monitor_t::on_construct>(this);
         this->storage.on_update().template connect<&storage_monitor_t::on_update>(this);
@@ -60,6 +108,9 @@ public:
     void on_construct(const entt::entity entity,
                       const T &value) {
         static_entity_t static_entity = this->entities.increase_ref(entity);
+        this->touch(static_entity);
+        this->counters.record_construct();
+        track_checksum<T>(this->entities, this->id, static_entity, nullptr, &value);
         this->changes.emplace_back(
             std::make_unique<construct_change_t<T> >(static_entity, value));
     }
@@ -67,7 +118,13 @@ public:
     void on_update(const entt::entity entity,
                    const T &old_value,
                    const T &new_value) {
+        if (is_noop_update(old_value, new_value)) {
+            return;
+        }
         static_entity_t static_entity = this->entities.get_static_entity(entity);
+        this->touch(static_entity);
+        this->counters.record_update();
+        track_checksum(this->entities, this->id, static_entity, &old_value, &new_value);
         this->changes.emplace_back(std::make_unique<update_change_t<T> >(
             static_entity,
             old_value,
@@ -77,7 +134,10 @@ public:
     void on_destruct(const entt::entity entity,
                      const T &old_value) {
         static_entity_t static_entity = this->entities.get_static_entity(entity);
-        this->entities.decrease_ref(static_entity);
+        this->touch(static_entity);
+        track_checksum<T>(this->entities, this->id, static_entity, &old_value, nullptr);
+        this->entities.release(static_entity);
+        this->counters.record_destruct();
         this->changes.emplace_back(
             std::make_unique<destruct_change_t<T> >(static_entity, old_value));
     }
@@ -92,6 +152,17 @@ private:
     static_entities_t &entities;
     entt::storage_type_t<T> &storage;
     std::vector<std::unique_ptr<change_t<T> > > changes;
+    [[no_unique_address]] typename Metrics::component_handle_t counters;
+    uint64_t marked_epoch = 0;
+
+    void touch(const static_entity_t static_entity) {
+        this->entities.touch(static_entity);
+        // The storage only has to be marked once per epoch
+        if (this->marked_epoch != this->entities.current_epoch()) {
+            this->marked_epoch = this->entities.current_epoch();
+            this->entities.mark_storage_changed(this->id);
+        }
+    }
 };
 }
 
@@ -0,0 +1,132 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#ifndef ECS_HISTORY_TRACING_HPP
+#define ECS_HISTORY_TRACING_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+namespace ecs_history::tracing {
+
+/**
+ * Writes the recorded zones of all threads as Chrome trace JSON, viewable in chrome://tracing
+ * or Perfetto. Writes an empty trace unless built with ECS_HISTORY_TRACING. Zones recorded
+ * while writing may be missing; zones overwritten while they are read are skipped.
+ */
+void write_chrome_trace(std::ostream &out);
+
+/**
+ * Drops the recorded zones of all threads. Call it while no thread records zones.
+ */
+void clear();
+
+#ifdef ECS_HISTORY_TRACING
+
+struct zone_event_t {
+    const char *name;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint64_t count;
+    uint64_t bytes;
+};
+
+/**
+ * Ring buffer of the zones of one thread. Only its thread writes; once full the oldest zones
+ * are overwritten. Every slot is a seqlock, so readers detect zones overwritten while they
+ * read them instead of racing with the writer.
+ */
+struct thread_buffer_t {
+    static constexpr size_t CAPACITY = 1 << 14;
+
+    struct slot_t {
+        // 2 * index + 1 while the zone with that index is written, 2 * index + 2 once it is complete
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<const char *> name{nullptr};
+        std::atomic<uint64_t> start_ns{0};
+        std::atomic<uint64_t> end_ns{0};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> bytes{0};
+    };
+
+    uint32_t thread_id = 0;
+    std::atomic<uint64_t> head{0};
+    std::array<slot_t, CAPACITY> slots{};
+
+    void push(const zone_event_t &event) {
+        const uint64_t index = this->head.load(std::memory_order_relaxed);
+        auto &slot = this->slots[index & (CAPACITY - 1)];
+        slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.name.store(event.name, std::memory_order_relaxed);
+        slot.start_ns.store(event.start_ns, std::memory_order_relaxed);
+        slot.end_ns.store(event.end_ns, std::memory_order_relaxed);
+        slot.count.store(event.count, std::memory_order_relaxed);
+        slot.bytes.store(event.bytes, std::memory_order_relaxed);
+        slot.sequence.store(2 * index + 2, std::memory_order_release);
+        this->head.store(index + 1, std::memory_order_release);
+    }
+
+    /**
+     * Reads the zone with the given index. Returns false if it was overwritten or is being written.
+     */
+    bool read(const uint64_t index, zone_event_t &event) const {
+        const auto &slot = this->slots[index & (CAPACITY - 1)];
+        const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * index + 2) {
+            return false;
+        }
+        event = {slot.name.load(std::memory_order_relaxed),
+                 slot.start_ns.load(std::memory_order_relaxed),
+                 slot.end_ns.load(std::memory_order_relaxed),
+                 slot.count.load(std::memory_order_relaxed),
+                 slot.bytes.load(std::memory_order_relaxed)};
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.sequence.load(std::memory_order_relaxed) == sequence;
+    }
+};
+
+/**
+ * Buffer of the calling thread, registered for export on first use.
+ */
+thread_buffer_t &thread_buffer();
+
+uint64_t now_ns();
+
+class zone_t {
+    const char *name;
+    uint64_t start_ns;
+
+public:
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+
+    explicit zone_t(const char *name) : name(name), start_ns(now_ns()) {
+    }
+
+    zone_t(const zone_t &) = delete;
+
+    zone_t &operator=(const zone_t &) = delete;
+
+    ~zone_t() {
+        thread_buffer().push({this->name, this->start_ns, now_ns(), this->count, this->bytes});
+    }
+};
+
+#define ECS_HISTORY_ZONE(zone, name) ::ecs_history::tracing::zone_t zone{name}
+#define ECS_HISTORY_ZONE_COUNT(zone, value) (zone).count = static_cast<uint64_t>(value)
+#define ECS_HISTORY_ZONE_BYTES(zone, value) (zone).bytes = static_cast<uint64_t>(value)
+
+#else
+
+#define ECS_HISTORY_ZONE(zone, name) static_cast<void>(0)
+#define ECS_HISTORY_ZONE_COUNT(zone, value) static_cast<void>(0)
+#define ECS_HISTORY_ZONE_BYTES(zone, value) static_cast<void>(0)
+
+#endif
+}
+
+#endif //ECS_HISTORY_TRACING_HPP
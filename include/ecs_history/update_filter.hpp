@@ -0,0 +1,78 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#ifndef ECS_HISTORY_UPDATE_FILTER_HPP
+#define ECS_HISTORY_UPDATE_FILTER_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace ecs_history {
+
+/**
+ * Specialize as std::true_type to drop updates whose new value has the same bytes as the old one.
+ * Only for trivially copyable components. Padding bytes are compared too, so values that only
+ * differ in padding are still recorded.
+ */
+template<typename T>
+struct drop_noop_updates_t : std::false_type {
+};
+
+template<typename T>
+constexpr bool drop_noop_updates_v = drop_noop_updates_t<T>::value;
+
+/**
+ * Compares two buffers 16 bytes at a time.
+ */
+inline bool same_bytes(const void *lhs, const void *rhs, const size_t size) {
+    const auto *a = static_cast<const unsigned char *>(lhs);
+    const auto *b = static_cast<const unsigned char *>(rhs);
+    size_t offset = 0;
+#if defined(__SSE2__)
+    for (; offset + 16 <= size; offset += 16) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + offset));
+        const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + offset));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xffff) {
+            return false;
+        }
+    }
+#elif defined(__ARM_NEON)
+    for (; offset + 16 <= size; offset += 16) {
+        const uint8x16_t equal = vceqq_u8(vld1q_u8(a + offset), vld1q_u8(b + offset));
+        if (vminvq_u8(equal) != 0xff) {
+            return false;
+        }
+    }
+#endif
+    return std::memcmp(a + offset, b + offset, size - offset) == 0;
+}
+
+/**
+ * Returns true if an update from old_value to new_value can be dropped.
+ */
+template<typename T>
+bool is_noop_update(const T &old_value, const T &new_value) {
+    if constexpr (drop_noop_updates_v<T>) {
+        static_assert(std::is_trivially_copyable_v<T>,
+                      "drop_noop_updates_t requires a trivially copyable component");
+        if constexpr (sizeof(T) <= 16) {
+            // Small enough for the compiler to inline the comparison
+            return std::memcmp(&old_value, &new_value, sizeof(T)) == 0;
+        } else {
+            return same_bytes(&old_value, &new_value, sizeof(T));
+        }
+    } else {
+        return false;
+    }
+}
+}
+
+#endif //ECS_HISTORY_UPDATE_FILTER_HPP
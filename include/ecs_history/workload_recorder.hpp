@@ -0,0 +1,196 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#ifndef ECS_HISTORY_WORKLOAD_RECORDER_HPP
+#define ECS_HISTORY_WORKLOAD_RECORDER_HPP
+
+#include <functional>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <cereal/archives/portable_binary.hpp>
+#include <entt/entt.hpp>
+
+#include "ecs_history/serialization/codec.hpp"
+
+namespace ecs_history {
+
+/**
+ * Workload trace format
+ *
+ * header: u32 magic, u16 version
+ * then records, each starting with a u8 workload_event_type_t:
+ * TYPE:      u32 component id, u32 size of the component type, u8 1 if values are serialized
+ * CONSTRUCT: varint type index, varint entity, varint byte count, value bytes
+ * UPDATE:    as CONSTRUCT, with the new value
+ * DESTRUCT:  varint type index, varint entity
+ * COMMIT:    nothing
+ *
+ * Types are numbered in the order of their TYPE records, which precede their first event.
+ * Entities are the registry entities of the recording process. Values are the bytes in memory
+ * for trivially copyable components and the serialized value for others. Version 1 traces
+ * have no serialized flag, their types are read as serialized.
+ */
+constexpr uint32_t WORKLOAD_MAGIC = 0x57534345;
+constexpr uint16_t WORKLOAD_VERSION = 2;
+
+enum class workload_event_type_t : uint8_t {
+    TYPE = 0,
+    CONSTRUCT = 1,
+    UPDATE = 2,
+    DESTRUCT = 3,
+    COMMIT = 4
+};
+
+struct workload_type_t {
+    entt::id_type id;
+    uint32_t size;
+    /**
+     * Values are serialized with codec::save rather than copied from memory.
+     */
+    bool serialized;
+};
+
+struct workload_event_t {
+    workload_event_type_t type;
+    uint32_t component;
+    uint32_t entity;
+    std::string value;
+};
+
+/**
+ * Records the events of monitored storages and commit boundaries into a workload trace,
+ * to replay production traffic offline, see test/replay.cpp.
+ *
+ * Storages are watched through their own signals, so the recorder sees every event a
+ * storage_monitor_t sees, including updates it drops as no-ops. Events have to come from
+ * one thread.
+ */
+class workload_recorder_t {
+    std::ostream &out;
+    cereal::PortableBinaryOutputArchive archive;
+    std::ostringstream scratch;
+    cereal::PortableBinaryOutputArchive scratch_archive;
+    std::unordered_map<entt::id_type, uint32_t> type_indices;
+    std::vector<std::function<void()> > disconnects;
+    uint64_t event_count = 0;
+    uint64_t commit_count = 0;
+
+    uint32_t type_index(entt::id_type id, size_t size, bool serialized);
+
+    template<typename T>
+    uint32_t type_index() {
+        return this->type_index(entt::type_hash<T>::value(),
+                                sizeof(T),
+                                entt::component_traits<T>::page_size != 0u && !std::is_trivially_copyable_v<T>);
+    }
+
+    void write_event(workload_event_type_t type, uint32_t component, entt::entity entity);
+
+    void write_value(std::string_view bytes);
+
+    template<typename T>
+    void write_value(const T &value) {
+        if constexpr (entt::component_traits<T>::page_size == 0u) {
+            this->write_value(std::string_view{});
+        } else if constexpr (std::is_trivially_copyable_v<T>) {
+            this->write_value(std::string_view{reinterpret_cast<const char *>(&value), sizeof(T)});
+        } else {
+            this->scratch.str({});
+            codec::save(this->scratch_archive, value);
+            this->write_value(this->scratch.view());
+        }
+    }
+
+    template<typename T>
+    void on_construct(const entt::entity entity, const T &value) {
+        this->write_event(workload_event_type_t::CONSTRUCT,
+                          this->type_index<T>(),
+                          entity);
+        this->write_value(value);
+    }
+
+    template<typename T>
+    void on_update(const entt::entity entity, const T &, const T &new_value) {
+        this->write_event(workload_event_type_t::UPDATE,
+                          this->type_index<T>(),
+                          entity);
+        this->write_value(new_value);
+    }
+
+    template<typename T>
+    void on_destruct(const entt::entity entity, const T &) {
+        this->write_event(workload_event_type_t::DESTRUCT,
+                          this->type_index<T>(),
+                          entity);
+    }
+
+public:
+    explicit workload_recorder_t(std::ostream &out);
+
+    workload_recorder_t(const workload_recorder_t &) = delete;
+
+    workload_recorder_t &operator=(const workload_recorder_t &) = delete;
+
+    /**
+     * Stops watching all storages and flushes the trace.
+     */
+    ~workload_recorder_t();
+
+    template<typename T>
+    void watch(entt::storage_type_t<T> &storage) {
+        storage.on_construct().template connect<&workload_recorder_t::on_construct<T> >(this);
+        storage.on_update().template connect<&workload_recorder_t::on_update<T> >(this);
+        storage.on_destroy().template connect<&workload_recorder_t::on_destruct<T> >(this);
+        this->disconnects.emplace_back([this, &storage] {
+            storage.on_construct().template disconnect<&workload_recorder_t::on_construct<T> >(this);
+            storage.on_update().template disconnect<&workload_recorder_t::on_update<T> >(this);
+            storage.on_destroy().template disconnect<&workload_recorder_t::on_destruct<T> >(this);
+        });
+    }
+
+    /**
+     * Marks a commit boundary, call it next to create_commit.
+     */
+    void commit();
+
+    [[nodiscard]] uint64_t events() const {
+        return this->event_count;
+    }
+
+    [[nodiscard]] uint64_t commits() const {
+        return this->commit_count;
+    }
+};
+
+/**
+ * Reads a trace written by workload_recorder_t event by event.
+ */
+class workload_reader_t {
+    std::istream &in;
+    cereal::PortableBinaryInputArchive archive;
+    uint16_t version = 0;
+    std::vector<workload_type_t> component_types;
+
+public:
+    explicit workload_reader_t(std::istream &in);
+
+    /**
+     * Returns the next event, or nullopt at the end of the trace. TYPE records are consumed
+     * and added to types.
+     */
+    std::optional<workload_event_t> next();
+
+    [[nodiscard]] const std::vector<workload_type_t> &types() const {
+        return this->component_types;
+    }
+};
+}
+
+#endif //ECS_HISTORY_WORKLOAD_RECORDER_HPP
@@ -2,9 +2,15 @@
 // Created by felix on 12/24/25.
 //
 
+#include <algorithm>
+#include <ranges>
+#include <sstream>
+#include <unordered_set>
 #include <utility>
 
 #include "ecs_history/commit.hpp"
+#include "ecs_history/serialization/serialization.hpp"
+#include "ecs_history/tracing.hpp"
 
 using namespace ecs_history;
 
@@ -38,6 +44,10 @@ commit_t::commit_t(
 
 std::unique_ptr<commit_t> commit_t::invert() {
     auto inverted_commit = std::make_unique<commit_t>();
+    // Destroyed entities were removed after all other changes, so they are restored first
+    for (const auto &base_change_set : this->destroyed_components) {
+        inverted_commit->change_sets.push_back(base_change_set->invert());
+    }
     for (const auto &base_change_set : this->change_sets) {
         inverted_commit->change_sets.push_back(base_change_set->invert());
     }
@@ -55,20 +65,117 @@ std::unique_ptr<commit_t> commit_t::invert() {
 }
 
 size_t commit_t::size() const {
-    size_t size = 0;
+    size_t size = memory::heap_block(sizeof(commit_t)) +
+                  memory::unordered_map_bytes(this->entity_versions) +
+                  memory::vector_bytes(this->change_sets);
     for (const auto &change_set : this->change_sets) {
         size += change_set->size();
     }
+    size += memory::vector_bytes(this->destroyed_entities) +
+            memory::vector_bytes(this->destroyed_components);
+    for (const auto &change_set : this->destroyed_components) {
+        size += change_set->size();
+    }
+    size += memory::unordered_map_bytes(this->storage_checksums);
+    std::lock_guard lock(this->encoding.mutex);
+    for (const auto &bytes : this->encoding.bytes) {
+        if (bytes != nullptr) {
+            size += memory::heap_block(bytes->capacity() + 1);
+        }
+    }
     return size;
 }
 
+std::shared_ptr<const std::string> commit_t::encoded(const std::endian byte_order) const {
+    std::lock_guard lock(this->encoding.mutex);
+    const bool little_endian = byte_order == std::endian::little;
+    auto &bytes = this->encoding.bytes[little_endian];
+    if (bytes == nullptr) {
+        std::ostringstream stream;
+        {
+            cereal::PortableBinaryOutputArchive archive(
+                stream,
+                little_endian
+                    ? cereal::PortableBinaryOutputArchive::Options::LittleEndian()
+                    : cereal::PortableBinaryOutputArchive::Options::BigEndian());
+            serialization::encode_commit(archive, *this);
+        }
+        bytes = std::make_shared<const std::string>(std::move(stream).str());
+    }
+    return bytes;
+}
+
+void commit_t::set_encoded(std::shared_ptr<const std::string> bytes) {
+    if (bytes == nullptr || bytes->empty()) {
+        throw std::runtime_error("Tried to set encoding without archive header");
+    }
+    std::lock_guard lock(this->encoding.mutex);
+    this->encoding.bytes = {};
+    // The header of a portable binary archive is 1 for little endian data
+    const bool little_endian = (*bytes)[0] == 1;
+    this->encoding.bytes[little_endian] = std::move(bytes);
+}
+
+void commit_t::invalidate() {
+    std::lock_guard lock(this->encoding.mutex);
+    this->encoding.bytes = {};
+}
+
+size_t commit_t::count() const {
+    size_t count = 0;
+    for (const auto &change_set : this->change_sets) {
+        count += change_set->count();
+    }
+    for (const auto &change_set : this->destroyed_components) {
+        count += change_set->count();
+    }
+    return count;
+}
+
+size_t commit_t::drop_noop_updates() {
+    size_t dropped = 0;
+    for (const auto &change_set : this->change_sets) {
+        dropped += change_set->drop_noop_updates();
+    }
+    if (dropped != 0) {
+        this->invalidate();
+    }
+    return dropped;
+}
+
 std::unique_ptr<commit_t> ecs_history::create_commit(
     const std::vector<std::unique_ptr<base_storage_monitor_t> > &monitors,
     static_entities_t &static_entities) {
+    ECS_HISTORY_ZONE(zone, "create_commit");
     auto commit = std::make_unique<commit_t>();
     for (const auto &monitor : monitors) {
         commit->change_sets.push_back(monitor->commit());
     }
+    static_entities.release_deferred();
+    ECS_HISTORY_ZONE_COUNT(zone, commit->count());
+
+    if (static_entities.has_checksum_tracking()) {
+        commit->checksum = static_entities.checksum();
+        for (const auto &change_set : commit->change_sets) {
+            if (change_set->count() != 0) {
+                commit->storage_checksums[change_set->id] = static_entities.storage_checksum(
+                    change_set->id);
+            }
+        }
+    }
+
+    const auto destroyed = static_entities.take_destroyed_entities();
+    commit->destroyed_entities.reserve(destroyed.size());
+    for (const auto &static_entity : destroyed | std::views::keys) {
+        commit->destroyed_entities.push_back(static_entity);
+    }
+    std::ranges::sort(commit->destroyed_entities);
+
+    if (static_entities.has_eager_versions()) {
+        commit->entity_versions = static_entities.take_pending_versions();
+        commit->entity_versions.insert(destroyed.begin(), destroyed.end());
+        return commit;
+    }
 
     std::unordered_set<static_entity_t> commit_entities;
     for (const auto &change_set : commit->change_sets) {
@@ -83,6 +190,7 @@ std::unique_ptr<commit_t> ecs_history::create_commit(
                 static_entity);
         }
     }
+    commit->entity_versions.insert(destroyed.begin(), destroyed.end());
 
     return std::move(commit);
 }
@@ -97,29 +205,233 @@ bool ecs_history::can_apply_commit(entt::registry &reg, const commit_t &commit)
                                });
 }
 
+bool ecs_history::can_apply_commits(entt::registry &reg, const std::span<const commit_t *const> commits) {
+    const auto &static_entities = reg.ctx().get<static_entities_t>();
+    // Versions after the commits checked so far, nullopt for the entities they destroyed
+    std::unordered_map<static_entity_t, std::optional<entity_version_t> > versions;
+    for (const auto *commit : commits) {
+        for (const auto &[static_entity, version] : commit->entity_versions) {
+            std::optional<entity_version_t> current;
+            if (const auto it = versions.find(static_entity); it != versions.end()) {
+                current = it->second;
+            } else if (static_entities.has_entity(static_entity)) {
+                current = static_entities.get_version(static_entity);
+            }
+            if (current.has_value() && *current != version) {
+                return false;
+            }
+            versions[static_entity] = static_cast<entity_version_t>(commit->undo ? version - 1 : version + 1);
+        }
+        for (const auto static_entity : commit->destroyed_entities) {
+            versions[static_entity] = std::nullopt;
+        }
+    }
+    return true;
+}
+
+bool ecs_history::checksum_matches(const static_entities_t &static_entities,
+                                   const commit_t &commit) {
+    return !commit.checksum.has_value() || *commit.checksum == static_entities.checksum();
+}
+
+std::vector<entt::id_type> ecs_history::diverging_storages(const static_entities_t &static_entities,
+                                                           const commit_t &commit) {
+    std::vector<entt::id_type> storages;
+    for (const auto &[id, checksum] : commit.storage_checksums) {
+        if (static_entities.storage_checksum(id) != checksum) {
+            storages.push_back(id);
+        }
+    }
+    return storages;
+}
+
+void ecs_history::apply_entity_versions(static_entities_t &static_entities,
+                                        const commit_t &commit) {
+    for (const auto &[entity, version] : commit.entity_versions) {
+        if (static_entities.has_entity(entity)) {
+            commit.undo
+                ? static_entities.set_version(entity, version - 1)
+                : static_entities.set_version(entity, version + 1);
+        } else {
+            // Versions in a commit are the ones before the commit was applied
+            static_entities.create(entity, commit.undo ? version - 1 : version + 1);
+        }
+    }
+}
+
+void ecs_history::apply_destroyed_entities(entt::registry &reg,
+                                           const std::vector<std::unique_ptr<base_storage_monitor_t> > &
+                                           monitors,
+                                           const commit_t &commit) {
+    auto &static_entities = reg.ctx().get<static_entities_t>();
+    std::vector<static_entity_t> alive;
+    for (const auto static_entity : commit.destroyed_entities) {
+        if (static_entities.has_entity(static_entity)) {
+            alive.push_back(static_entity);
+        }
+    }
+    if (alive.empty()) {
+        return;
+    }
+
+    if (!commit.destroyed_components.empty()) {
+        // Applied before, e.g. redone after an undo
+        for (const auto &change_set : commit.destroyed_components) {
+            change_set->apply(reg, static_entities);
+            static_entities.mark_storage_changed(change_set->id);
+        }
+    } else {
+        for (const auto &monitor : monitors) {
+            auto change_set = monitor->remove_entities(alive);
+            if (change_set->count() != 0) {
+                static_entities.mark_storage_changed(change_set->id);
+                commit.destroyed_components.push_back(std::move(change_set));
+            }
+        }
+    }
+
+    // Reference counts are not kept while removing, so the entities are dropped directly
+    for (const auto static_entity : alive) {
+        if (!static_entities.has_entity(static_entity)) {
+            continue;
+        }
+        // Storages without a monitor, e.g. in a replica applying commits without any
+        const auto entt = static_entities.get_entity(static_entity);
+        for (auto [id, storage] : reg.storage()) {
+            storage.remove(entt);
+        }
+        static_entities.destroy(static_entity);
+    }
+}
+
 void ecs_history::apply_commit(entt::registry &reg,
                                const std::vector<std::unique_ptr<base_storage_monitor_t> > &
                                monitors,
                                const commit_t &commit) {
+    apply_commit_using(reg,
+                       monitors,
+                       commit,
+                       [](const base_change_set_t &change_set,
+                          entt::registry &registry,
+                          static_entities_t &static_entities) {
+                           change_set.apply(registry, static_entities);
+                       });
+}
+
+namespace {
+/**
+ * Change sets of the commits grouped by component, in the order components first appear.
+ */
+std::vector<std::vector<const base_change_set_t *> > group_change_sets(
+    const std::span<const commit_t *const> commits) {
+    std::vector<std::vector<const base_change_set_t *> > groups;
+    std::unordered_map<entt::id_type, size_t> group_of;
+    for (const auto *commit : commits) {
+        for (const auto &change_set : commit->change_sets) {
+            const auto [it, inserted] = group_of.try_emplace(change_set->id, groups.size());
+            if (inserted) {
+                groups.emplace_back();
+            }
+            groups[it->second].push_back(change_set.get());
+        }
+    }
+    return groups;
+}
+
+std::unique_ptr<base_change_set_t> coalesce_group(const std::vector<const base_change_set_t *> &group) {
+    return group.front()->coalesce(group);
+}
+
+/**
+ * Whether a commit touches an entity destroyed by an earlier one, which brings it back.
+ */
+bool recreates_entities(const std::span<const commit_t *const> commits) {
+    std::unordered_set<static_entity_t> destroyed;
+    for (const auto *commit : commits) {
+        for (const auto &static_entity : commit->entity_versions | std::views::keys) {
+            if (destroyed.contains(static_entity)) {
+                return true;
+            }
+        }
+        destroyed.insert(commit->destroyed_entities.begin(), commit->destroyed_entities.end());
+    }
+    return false;
+}
+}
+
+std::unique_ptr<commit_t> ecs_history::coalesce_commits(const std::span<const commit_t *const> commits) {
+    auto coalesced = std::make_unique<commit_t>();
+    for (const auto &group : group_change_sets(commits)) {
+        coalesced->change_sets.push_back(coalesce_group(group));
+    }
+    std::unordered_set<static_entity_t> destroyed;
+    for (const auto *commit : commits) {
+        for (const auto &[static_entity, version] : commit->entity_versions) {
+            destroyed.erase(static_entity);
+            coalesced->entity_versions.try_emplace(static_entity, version);
+        }
+        destroyed.insert(commit->destroyed_entities.begin(), commit->destroyed_entities.end());
+    }
+    coalesced->destroyed_entities.assign(destroyed.begin(), destroyed.end());
+    std::ranges::sort(coalesced->destroyed_entities);
+    return coalesced;
+}
+
+std::unique_ptr<commit_t> ecs_history::coalesce_commits(const std::span<const commit_t *const> commits,
+                                                        static_entities_t &static_entities) {
+    auto coalesced = coalesce_commits(commits);
+    for (const auto &[static_entity, version] : coalesced->entity_versions) {
+        if (static_entities.has_entity(static_entity)) {
+            static_entities.set_version(static_entity, version + 1);
+        }
+    }
+    return coalesced;
+}
+
+void ecs_history::apply_commits(entt::registry &reg,
+                                const std::vector<std::unique_ptr<base_storage_monitor_t> > &
+                                monitors,
+                                const std::span<const commit_t *const> commits) {
+    if (commits.size() == 1 || recreates_entities(commits) || !can_apply_commits(reg, commits)) {
+        for (const auto *commit : commits) {
+            apply_commit(reg, monitors, *commit);
+        }
+        return;
+    }
     auto &static_entities = reg.ctx().get<static_entities_t>();
     for (auto &monitor : monitors) {
         monitor->disable();
     }
 
-    for (const auto &[entity, version] : commit.entity_versions) {
-        if (static_entities.has_entity(entity)) {
-            commit.undo
-                ? static_entities.set_version(entity, version - 1)
-                : static_entities.set_version(entity, version + 1);
-        } else {
-            static_entities.create(entity, version);
+    for (const auto *commit : commits) {
+        apply_entity_versions(static_entities, *commit);
+    }
+    const auto groups = group_change_sets(commits);
+    std::vector<std::unique_ptr<base_change_set_t> > coalesced;
+    std::vector<size_t> first_destructs;
+    coalesced.reserve(groups.size());
+    for (const auto &group : groups) {
+        coalesced.push_back(coalesce_group(group));
+        size_t first_destruct = coalesced.back()->count();
+        while (first_destruct > 0 && coalesced.back()->is_destruct(first_destruct - 1)) {
+            first_destruct--;
         }
+        first_destructs.push_back(first_destruct);
     }
-    for (const auto &change_set : commit.change_sets) {
-        change_set->apply(reg, static_entities);
+    // Destructs of all components last, they may release the last reference of an entity
+    for (size_t i = 0; i < coalesced.size(); ++i) {
+        coalesced[i]->apply_range(reg, static_entities, 0, first_destructs[i]);
+    }
+    for (size_t i = 0; i < coalesced.size(); ++i) {
+        coalesced[i]->apply_range(reg, static_entities, first_destructs[i], coalesced[i]->count());
+        coalesced[i]->fill_pre_images(groups[i]);
+        static_entities.mark_storage_changed(coalesced[i]->id);
+    }
+    for (const auto *commit : commits) {
+        apply_destroyed_entities(reg, monitors, *commit);
     }
 
     for (auto &monitor : monitors) {
         monitor->enable();
     }
-}
\ No newline at end of file
+}
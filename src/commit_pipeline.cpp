@@ -0,0 +1,122 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#include "ecs_history/commit_pipeline.hpp"
+#include "ecs_history/serialization/serialization.hpp"
+
+using namespace ecs_history;
+
+commit_pipeline_t::commit_pipeline_t(const size_t capacity,
+                                     compressor_t compressor,
+                                     completion_callback_t on_complete)
+    : jobs(capacity),
+      shipped(capacity),
+      compressor(std::move(compressor)),
+      on_complete(std::move(on_complete)),
+      worker(&commit_pipeline_t::run, this) {
+}
+
+commit_pipeline_t::~commit_pipeline_t() {
+    this->stopping.store(true, std::memory_order_release);
+    for (auto *signal : {&this->job_signal,
+                         &this->job_space_signal,
+                         &this->shipped_signal,
+                         &this->shipped_space_signal}) {
+        signal->fetch_add(1, std::memory_order_release);
+        signal->notify_all();
+    }
+    this->worker.join();
+}
+
+bool commit_pipeline_t::try_submit(const commit_id id, std::shared_ptr<const commit_t> commit) {
+    job_t job{id, std::move(commit)};
+    if (!this->jobs.try_push(job)) {
+        return false;
+    }
+    this->job_signal.fetch_add(1, std::memory_order_release);
+    this->job_signal.notify_one();
+    return true;
+}
+
+void commit_pipeline_t::submit(const commit_id id, std::shared_ptr<const commit_t> commit) {
+    while (true) {
+        const auto observed = this->job_space_signal.load(std::memory_order_acquire);
+        if (this->try_submit(id, commit)) {
+            return;
+        }
+        spdlog::debug("commit pipeline is full. waiting");
+        this->job_space_signal.wait(observed, std::memory_order_acquire);
+    }
+}
+
+std::optional<shipped_commit_t> commit_pipeline_t::poll() {
+    auto shipped_commit = this->shipped.try_pop();
+    if (shipped_commit.has_value()) {
+        // Wakes up a worker waiting to ship
+        this->shipped_space_signal.fetch_add(1, std::memory_order_release);
+        this->shipped_space_signal.notify_one();
+    }
+    return shipped_commit;
+}
+
+std::optional<shipped_commit_t> commit_pipeline_t::wait() {
+    while (true) {
+        const auto observed = this->shipped_signal.load(std::memory_order_acquire);
+        if (auto shipped_commit = this->poll()) {
+            return shipped_commit;
+        }
+        if (this->stopping.load(std::memory_order_acquire)) {
+            return std::nullopt;
+        }
+        this->shipped_signal.wait(observed, std::memory_order_acquire);
+    }
+}
+
+std::shared_ptr<const std::string> commit_pipeline_t::serialize(const commit_t &commit) const {
+    auto bytes = commit.encoded();
+    if (this->compressor) {
+        return std::make_shared<const std::string>(this->compressor(*bytes));
+    }
+    return bytes;
+}
+
+void commit_pipeline_t::run() {
+    while (true) {
+        const auto observed = this->job_signal.load(std::memory_order_acquire);
+        auto job = this->jobs.try_pop();
+        if (!job.has_value()) {
+            if (this->stopping.load(std::memory_order_acquire)) {
+                return;
+            }
+            this->job_signal.wait(observed, std::memory_order_acquire);
+            continue;
+        }
+        // Wakes up a blocked submit
+        this->job_space_signal.fetch_add(1, std::memory_order_release);
+        this->job_space_signal.notify_one();
+
+        shipped_commit_t shipped_commit{job->id, this->serialize(*job->commit)};
+        job->commit.reset();
+        const size_t bytes = shipped_commit.bytes->size();
+
+        // The network thread applies backpressure by not polling
+        while (true) {
+            const auto space = this->shipped_space_signal.load(std::memory_order_acquire);
+            if (this->shipped.try_push(shipped_commit)) {
+                break;
+            }
+            if (this->stopping.load(std::memory_order_acquire)) {
+                spdlog::warn("dropping serialized commit while stopping commit pipeline");
+                return;
+            }
+            this->shipped_space_signal.wait(space, std::memory_order_acquire);
+        }
+        this->shipped_signal.fetch_add(1, std::memory_order_release);
+        this->shipped_signal.notify_all();
+
+        if (this->on_complete) {
+            this->on_complete(job->id, bytes);
+        }
+    }
+}
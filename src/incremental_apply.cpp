@@ -0,0 +1,75 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#include <algorithm>
+
+#include "ecs_history/incremental_apply.hpp"
+
+using namespace ecs_history;
+
+incremental_apply_t::incremental_apply_t(entt::registry &reg,
+                                         const std::vector<std::unique_ptr<base_storage_monitor_t> > &
+                                         monitors,
+                                         std::shared_ptr<const commit_t> commit)
+    : reg(reg), monitors(monitors), commit(std::move(commit)) {
+}
+
+incremental_apply_t::~incremental_apply_t() {
+    if (this->started && !this->finished) {
+        spdlog::warn("incremental apply of commit stopped after {} of {} changes",
+                     this->applied_changes,
+                     this->total());
+        for (auto &monitor : this->monitors) {
+            monitor->enable();
+        }
+    }
+}
+
+void incremental_apply_t::start() {
+    for (auto &monitor : this->monitors) {
+        monitor->disable();
+    }
+    apply_entity_versions(this->reg.ctx().get<static_entities_t>(), *this->commit);
+    this->started = true;
+}
+
+void incremental_apply_t::finish() {
+    apply_destroyed_entities(this->reg, this->monitors, *this->commit);
+    for (auto &monitor : this->monitors) {
+        monitor->enable();
+    }
+    this->finished = true;
+}
+
+bool incremental_apply_t::step(const apply_budget_t &budget) {
+    if (this->finished) {
+        return true;
+    }
+    if (!this->started) {
+        this->start();
+    }
+    auto &static_entities = this->reg.ctx().get<static_entities_t>();
+    size_t remaining = budget.max_changes;
+    while (this->change_set < this->commit->change_sets.size()) {
+        const auto &change_set = this->commit->change_sets[this->change_set];
+        const size_t count = change_set->count();
+        if (this->offset < count) {
+            if (remaining == 0 || (budget.deadline.has_value() &&
+                                   std::chrono::steady_clock::now() >= *budget.deadline)) {
+                return false;
+            }
+            const size_t end = this->offset + std::min({remaining, CLOCK_INTERVAL, count - this->offset});
+            change_set->apply_range(this->reg, static_entities, this->offset, end);
+            remaining -= end - this->offset;
+            this->applied_changes += end - this->offset;
+            this->offset = end;
+            continue;
+        }
+        static_entities.mark_storage_changed(change_set->id);
+        this->change_set++;
+        this->offset = 0;
+    }
+    this->finish();
+    return true;
+}
@@ -0,0 +1,175 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#include <algorithm>
+#include <sstream>
+
+#include "ecs_history/serialization/interest.hpp"
+
+using namespace ecs_history;
+using namespace ecs_history::serialization;
+
+bool interest_filter_t::same_as(const interest_filter_t &other) const {
+    if (this == &other) {
+        return true;
+    }
+    if (this->predicate || other.predicate) {
+        return false;
+    }
+    return this->components == other.components && this->entities == other.entities;
+}
+
+namespace {
+struct view_t {
+    const interest_filter_t *filter;
+    uint16_t change_sets = 0;
+    std::string body;
+    // Changes of the change set currently being filtered
+    uint32_t count = 0;
+    std::string changes;
+};
+
+void flush_change_set(view_t &view,
+                      const entt::id_type id,
+                      std::ostringstream &scratch,
+                      cereal::PortableBinaryOutputArchive &archive) {
+    if (view.count == 0) {
+        return;
+    }
+    scratch.str({});
+    archive(id);
+    archive(view.count);
+    view.body += scratch.view();
+    view.body += view.changes;
+    view.change_sets++;
+    view.count = 0;
+    view.changes.clear();
+}
+
+std::string finish(const view_t &view, const commit_t &commit) {
+    std::ostringstream stream;
+    {
+        cereal::PortableBinaryOutputArchive archive(stream);
+        // Versions move on with every change of an entity, including changes masked out by the
+        // component filter, otherwise the next commit including the entity would not apply
+        std::vector<std::pair<static_entity_t, entity_version_t> > versions;
+        for (const auto &[static_entity, version] : commit.entity_versions) {
+            if (view.filter->includes_entity(static_entity)) {
+                versions.emplace_back(static_entity, version);
+            }
+        }
+        archive(static_cast<uint32_t>(versions.size()));
+        for (const auto &[static_entity, version] : versions) {
+            archive(static_entity);
+            archive(version);
+        }
+        archive(view.change_sets);
+        archive(cereal::binary_data(view.body.data(), view.body.size()));
+        std::vector<static_entity_t> destroyed;
+        for (const auto static_entity : commit.destroyed_entities) {
+            if (view.filter->includes_entity(static_entity)) {
+                destroyed.push_back(static_entity);
+            }
+        }
+        archive(static_cast<uint32_t>(destroyed.size()));
+        for (const auto static_entity : destroyed) {
+            archive(static_entity);
+        }
+        // Checksums cover the whole registry, so filtered commits carry none
+        archive(false);
+    }
+    return std::move(stream).str();
+}
+}
+
+std::vector<std::shared_ptr<const std::string> > serialization::serialize_filtered_commit(
+    const commit_t &commit,
+    const std::vector<std::shared_ptr<const interest_filter_t> > &subscribers) {
+    // Group subscribers by filter, first by pointer and then by value
+    std::vector<view_t> views;
+    std::vector<size_t> subscriber_views;
+    subscriber_views.reserve(subscribers.size());
+    std::unordered_map<const interest_filter_t *, size_t> known_filters;
+    for (const auto &filter : subscribers) {
+        if (filter == nullptr) {
+            throw std::runtime_error("Tried to filter commit for subscriber without filter");
+        }
+        auto [it, inserted] = known_filters.try_emplace(filter.get(), views.size());
+        if (inserted) {
+            const auto same = std::ranges::find_if(views,
+                                                   [&filter](const view_t &view) {
+                                                       return view.filter->same_as(*filter);
+                                                   });
+            if (same == views.end()) {
+                views.push_back({filter.get()});
+            } else {
+                it->second = std::distance(views.begin(), same);
+            }
+        }
+        subscriber_views.push_back(it->second);
+    }
+    spdlog::debug("filtering commit for {} subscribers with {} distinct filters",
+                  subscribers.size(),
+                  views.size());
+
+    std::ostringstream scratch;
+    cereal::PortableBinaryOutputArchive archive(scratch);
+    std::vector<view_t *> interested;
+    std::vector<view_t *> matched;
+    for (const auto &change_set : commit.change_sets) {
+        interested.clear();
+        for (auto &view : views) {
+            if (view.filter->includes_component(change_set->id)) {
+                interested.push_back(&view);
+            }
+        }
+        if (interested.empty()) {
+            continue;
+        }
+
+        const size_t count = change_set->count();
+        for (size_t i = 0; i < count; ++i) {
+            const auto static_entity = change_set->entity_at(i);
+            matched.clear();
+            for (auto *view : interested) {
+                if (view->filter->includes_entity(static_entity)) {
+                    matched.push_back(view);
+                }
+            }
+            if (matched.empty()) {
+                continue;
+            }
+            if (!commit.destroyed_entities.empty() && change_set->is_destruct(i) &&
+                std::ranges::binary_search(commit.destroyed_entities, static_entity)) {
+                // Left out like in serialize_commit, the destroyed entities block removes it
+                continue;
+            }
+            // Every change is serialized once, independent of the number of views
+            scratch.str({});
+            change_set->serialize_change(i, archive);
+            const auto bytes = scratch.view();
+            for (auto *view : matched) {
+                view->changes += bytes;
+                view->count++;
+            }
+        }
+
+        for (auto *view : interested) {
+            flush_change_set(*view, change_set->id, scratch, archive);
+        }
+    }
+
+    std::vector<std::shared_ptr<const std::string> > buffers;
+    buffers.reserve(views.size());
+    for (const auto &view : views) {
+        buffers.push_back(std::make_shared<const std::string>(finish(view, commit)));
+    }
+
+    std::vector<std::shared_ptr<const std::string> > result;
+    result.reserve(subscribers.size());
+    for (const auto index : subscriber_views) {
+        result.push_back(buffers[index]);
+    }
+    return result;
+}
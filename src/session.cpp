@@ -0,0 +1,160 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#include <ranges>
+
+#include "ecs_history/serialization/session.hpp"
+
+using namespace ecs_history;
+using namespace ecs_history::serialization;
+
+void serialization::write_varint(cereal::PortableBinaryOutputArchive &archive, uint32_t value) {
+    while (value >= 0x80) {
+        archive(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    archive(static_cast<uint8_t>(value));
+}
+
+uint32_t serialization::read_varint(cereal::PortableBinaryInputArchive &archive) {
+    uint32_t value = 0;
+    for (unsigned shift = 0; shift < 35; shift += 7) {
+        uint8_t byte;
+        archive(byte);
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Invalid varint in session commit");
+}
+
+uint32_t session_encoder_t::bind(const static_entity_t static_entity,
+                                 std::vector<static_entity_t> &bindings) {
+    const auto it = this->indices.find(static_entity);
+    if (it != this->indices.end()) {
+        return it->second;
+    }
+    uint32_t index;
+    if (this->free_indices.empty()) {
+        index = this->next_index++;
+    } else {
+        index = this->free_indices.back();
+        this->free_indices.pop_back();
+    }
+    this->indices.emplace(static_entity, index);
+    bindings.push_back(static_entity);
+    return index;
+}
+
+void session_encoder_t::release(const static_entity_t static_entity) {
+    const auto it = this->indices.find(static_entity);
+    if (it == this->indices.end()) {
+        return;
+    }
+    this->released.push_back(it->second);
+    this->indices.erase(it);
+}
+
+void session_encoder_t::encode_commit(cereal::PortableBinaryOutputArchive &archive,
+                                      const commit_t &commit,
+                                      const static_entities_t *static_entities) {
+    // Indices released since the last commit can be reused from now on
+    write_varint(archive, static_cast<uint32_t>(this->released.size()));
+    for (const uint32_t index : this->released) {
+        write_varint(archive, index);
+    }
+    this->free_indices.insert(this->free_indices.end(), this->released.begin(), this->released.end());
+    this->released.clear();
+
+    std::vector<static_entity_t> entities;
+    for (const auto &static_entity : commit.entity_versions | std::views::keys) {
+        entities.push_back(static_entity);
+    }
+    std::vector<std::vector<size_t> > sent;
+    sent.reserve(commit.change_sets.size());
+    for (const auto &change_set : commit.change_sets) {
+        sent.push_back(sent_changes(commit, *change_set));
+        for (const size_t i : sent.back()) {
+            entities.push_back(change_set->entity_at(i));
+        }
+    }
+    entities.insert(entities.end(), commit.destroyed_entities.begin(), commit.destroyed_entities.end());
+    std::vector<static_entity_t> bindings;
+    std::vector<uint32_t> entity_indices;
+    entity_indices.reserve(entities.size());
+    for (const auto static_entity : entities) {
+        entity_indices.push_back(this->bind(static_entity, bindings));
+    }
+
+    write_varint(archive, static_cast<uint32_t>(bindings.size()));
+    for (const auto static_entity : bindings) {
+        write_varint(archive, this->indices.at(static_entity));
+        archive(static_entity);
+    }
+
+    auto next = entity_indices.begin();
+    archive(static_cast<uint32_t>(commit.entity_versions.size()));
+    for (const auto &version : commit.entity_versions | std::views::values) {
+        write_varint(archive, *next++);
+        archive(version);
+    }
+    archive(static_cast<uint16_t>(commit.change_sets.size()));
+    for (size_t set = 0; set < commit.change_sets.size(); ++set) {
+        const auto &change_set = commit.change_sets[set];
+        archive(change_set->id);
+        archive(static_cast<uint32_t>(sent[set].size()));
+        for (const size_t i : sent[set]) {
+            write_varint(archive, *next++);
+            change_set->serialize_change_body(i, archive);
+        }
+    }
+    write_varint(archive, static_cast<uint32_t>(commit.destroyed_entities.size()));
+    for (size_t i = 0; i < commit.destroyed_entities.size(); ++i) {
+        write_varint(archive, *next++);
+    }
+    serialize_commit_checksums(archive, commit);
+
+    if (static_entities != nullptr) {
+        for (const auto static_entity : entities) {
+            if (!static_entities->has_entity(static_entity)) {
+                this->release(static_entity);
+            }
+        }
+    }
+}
+
+void session_decoder_t::read_dictionary(cereal::PortableBinaryInputArchive &archive) {
+    const uint32_t releases = read_varint(archive);
+    for (uint32_t i = 0; i < releases; ++i) {
+        const uint32_t index = read_varint(archive);
+        if (index >= this->entities.size()) {
+            throw std::runtime_error("Session commit releases unknown index");
+        }
+        this->entities[index] = UNBOUND;
+    }
+    const uint32_t bindings = read_varint(archive);
+    // The encoder reuses released indices or appends, so no binding goes further than this
+    const size_t limit = this->entities.size() + bindings;
+    for (uint32_t i = 0; i < bindings; ++i) {
+        const uint32_t index = read_varint(archive);
+        static_entity_t static_entity;
+        archive(static_entity);
+        if (index >= limit) {
+            throw std::runtime_error("Session commit binds index out of range");
+        }
+        if (index >= this->entities.size()) {
+            this->entities.resize(index + 1, UNBOUND);
+        }
+        this->entities[index] = static_entity;
+    }
+}
+
+static_entity_t session_decoder_t::read_entity(cereal::PortableBinaryInputArchive &archive) const {
+    const uint32_t index = read_varint(archive);
+    if (index >= this->entities.size() || this->entities[index] == UNBOUND) {
+        throw std::runtime_error("Session commit references unbound index");
+    }
+    return this->entities[index];
+}
@@ -15,15 +15,58 @@ entt::entity static_entities_t::create() {
     this->static_entities.emplace(entity, static_entity);
     this->entities[static_entity] = {entity, 0};
     this->versions.emplace(static_entity, 0);
+    this->mark_entity_changed(static_entity);
     spdlog::debug("created new entity");
     return entity;
 }
 
-void static_entities_t::create(static_entity_t static_entity, entity_version_t version) {
+entt::entity static_entities_t::create(static_entity_t static_entity, entity_version_t version) {
     const auto entity = this->entity_storage.generate();
     this->entities[static_entity] = {entity, 0};
     this->static_entities.emplace(entity, static_entity);
     this->versions.emplace(static_entity, version);
+    this->mark_entity_changed(static_entity);
+    return entity;
+}
+
+std::vector<entt::entity> static_entities_t::create(
+    const std::vector<static_entity_t> &static_ids,
+    const std::vector<entity_version_t> &versions) {
+    if (static_ids.size() != versions.size()) {
+        throw std::runtime_error("every entity needs exactly one version");
+    }
+    this->reserve(this->static_entities.size() + static_ids.size());
+    std::vector<entt::entity> created(static_ids.size());
+    this->entity_storage.generate(created.begin(), created.end());
+    std::vector<static_entity_container_t> containers;
+    containers.reserve(static_ids.size());
+    for (size_t i = 0; i < static_ids.size(); ++i) {
+        containers.push_back({static_ids[i]});
+        this->entities[static_ids[i]] = {created[i], 0};
+        this->versions.emplace(static_ids[i], versions[i]);
+        if (this->epoch_tracking) {
+            this->add_changed(static_ids[i]);
+        }
+    }
+    this->static_entities.insert(created.begin(), created.end(), containers.begin());
+    spdlog::debug("created {} entities", created.size());
+    return created;
+}
+
+void static_entities_t::add_refs(const std::vector<static_entity_t> &static_ids,
+                                 const std::vector<uint16_t> &refs) {
+    for (size_t i = 0; i < static_ids.size(); ++i) {
+        if (refs[i] != 0) {
+            this->entities.at(static_ids[i]).ref_count += refs[i];
+        }
+    }
+}
+
+void static_entities_t::reserve(const size_t count) {
+    this->entity_storage.reserve(count);
+    this->static_entities.reserve(count);
+    this->entities.reserve(count);
+    this->versions.reserve(count);
 }
 
 bool static_entities_t::has_entity(const static_entity_t static_entity) const {
@@ -44,17 +87,79 @@ entt::entity static_entities_t::increase_ref(const static_entity_t static_entity
     return entt;
 }
 
+void static_entities_t::erase(const static_entity_t static_entity) {
+    const entt::entity entt = this->entities.at(static_entity).entt;
+    this->entity_storage.erase(entt);
+    this->static_entities.erase(entt);
+    this->versions.erase(static_entity);
+    this->pending_versions.erase(static_entity);
+    this->entities.erase(static_entity);
+    if (this->epoch_tracking) {
+        auto &destroyed_epoch = this->destroyed_epochs[static_entity];
+        if (destroyed_epoch != this->epoch) {
+            destroyed_epoch = this->epoch;
+            this->destroyed_by_epoch[this->epoch].push_back(static_entity);
+        }
+    }
+}
+
+void static_entities_t::add_changed(const static_entity_t static_entity) {
+    auto &changed_epoch = this->entity_epochs[static_entity];
+    if (changed_epoch == this->epoch) {
+        return;
+    }
+    changed_epoch = this->epoch;
+    // The current epoch is the last one, so this is the end of the map
+    auto it = this->changed_by_epoch.end();
+    if (it == this->changed_by_epoch.begin() || std::prev(it)->first != this->epoch) {
+        it = this->changed_by_epoch.emplace_hint(it, this->epoch, std::vector<static_entity_t>{});
+    } else {
+        --it;
+    }
+    it->second.push_back(static_entity);
+}
+
 entt::entity static_entities_t::decrease_ref(const static_entity_t static_entity) {
     auto &[entt, ref_count] = this->entities.at(static_entity);
+    const entt::entity entity = entt;
     ref_count--;
     if (ref_count == 0) {
-        this->entity_storage.erase(entt);
-        this->static_entities.erase(entt);
-        this->versions.erase(static_entity);
-        this->entities.erase(static_entity);
+        this->erase(static_entity);
         spdlog::debug("destroying entity without components");
     }
-    return entt;
+    return entity;
+}
+
+void static_entities_t::destroy(const static_entity_t static_entity) {
+    this->erase(static_entity);
+}
+
+entt::entity static_entities_t::release(const static_entity_t static_entity) {
+    if (this->entities.at(static_entity).ref_count == 1) {
+        const auto pending = this->pending_versions.find(static_entity);
+        this->destroyed_by_changes[static_entity] = pending == this->pending_versions.end()
+                                                        ? this->versions.at(static_entity)
+                                                        : pending->second;
+    }
+    return this->decrease_ref(static_entity);
+}
+
+void static_entities_t::release_deferred() {
+    std::vector<static_entity_t> released;
+    released.swap(this->deferred_releases);
+    for (const auto static_entity : released) {
+        this->release(static_entity);
+    }
+}
+
+std::unordered_map<static_entity_t, entity_version_t> static_entities_t::take_destroyed_entities() {
+    std::unordered_map<static_entity_t, entity_version_t> destroyed;
+    destroyed.swap(this->destroyed_by_changes);
+    std::erase_if(destroyed,
+                  [this](const auto &pair) {
+                      return this->has_entity(pair.first);
+                  });
+    return destroyed;
 }
 
 static_entity_t static_entities_t::get_static_entity(const entt::entity entt) const {
@@ -79,6 +184,7 @@ entity_version_t static_entities_t::get_version(
 void static_entities_t::set_version(const static_entity_t entity,
                                     const entity_version_t version) {
     this->versions[entity] = version;
+    this->mark_entity_changed(entity);
 }
 
 entity_version_t static_entities_t::increment_version(
@@ -86,5 +192,118 @@ entity_version_t static_entities_t::increment_version(
     if (!this->versions.contains(entity)) {
         throw std::runtime_error("entity does not exist in version handler");
     }
+    this->mark_entity_changed(entity);
     return this->versions.at(entity)++;
-}
\ No newline at end of file
+}
+
+void static_entities_t::set_eager_versions(const bool eager) {
+    this->eager_versions = eager;
+    if (!eager) {
+        this->pending_versions.clear();
+    }
+}
+
+std::unordered_map<static_entity_t, entity_version_t> static_entities_t::take_pending_versions() {
+    std::unordered_map<static_entity_t, entity_version_t> taken;
+    taken.swap(this->pending_versions);
+    return taken;
+}
+
+uint64_t static_entities_t::storage_epoch(const entt::id_type id) const {
+    const auto it = this->storage_epochs.find(id);
+    return it == this->storage_epochs.end() ? 0 : it->second;
+}
+
+void static_entities_t::set_checksum_tracking(const bool tracking) {
+    this->checksum_tracking = tracking;
+    if (!tracking) {
+        this->storage_checksums.clear();
+        this->total_checksum = 0;
+    }
+}
+
+void static_entities_t::set_storage_checksum(const entt::id_type id, const uint64_t checksum) {
+    uint64_t &current = this->storage_checksums[id];
+    this->total_checksum += checksum - current;
+    current = checksum;
+}
+
+uint64_t static_entities_t::storage_checksum(const entt::id_type id) const {
+    const auto it = this->storage_checksums.find(id);
+    return it == this->storage_checksums.end() ? 0 : it->second;
+}
+
+void static_entities_t::set_epoch_tracking(const bool tracking) {
+    this->epoch_tracking = tracking;
+    if (!tracking) {
+        this->entity_epochs.clear();
+        this->destroyed_epochs.clear();
+        this->changed_by_epoch.clear();
+        this->destroyed_by_epoch.clear();
+    }
+}
+
+namespace {
+/**
+ * Entities listed after since_epoch whose last epoch in epochs is the one they are listed in.
+ */
+std::vector<static_entity_t> listed_after(
+    const std::map<uint64_t, std::vector<static_entity_t> > &by_epoch,
+    const std::unordered_map<static_entity_t, uint64_t> &epochs,
+    const uint64_t since_epoch) {
+    std::vector<static_entity_t> listed;
+    for (auto it = by_epoch.upper_bound(since_epoch); it != by_epoch.end(); ++it) {
+        for (const auto static_entity : it->second) {
+            // Entities changed again later are only returned for their last epoch
+            if (const auto found = epochs.find(static_entity);
+                found != epochs.end() && found->second == it->first) {
+                listed.push_back(static_entity);
+            }
+        }
+    }
+    return listed;
+}
+
+/**
+ * Drops the lists up to until_epoch and the epochs of the entities not listed later.
+ */
+void prune_lists(std::map<uint64_t, std::vector<static_entity_t> > &by_epoch,
+                 std::unordered_map<static_entity_t, uint64_t> &epochs,
+                 const uint64_t until_epoch) {
+    const auto end = by_epoch.upper_bound(until_epoch);
+    for (auto it = by_epoch.begin(); it != end; ++it) {
+        for (const auto static_entity : it->second) {
+            if (const auto found = epochs.find(static_entity);
+                found != epochs.end() && found->second == it->first) {
+                epochs.erase(found);
+            }
+        }
+    }
+    by_epoch.erase(by_epoch.begin(), end);
+}
+}
+
+std::vector<static_entity_t> static_entities_t::changed_entities(const uint64_t since_epoch) const {
+    auto changed = listed_after(this->changed_by_epoch, this->entity_epochs, since_epoch);
+    std::erase_if(changed,
+                  [this](const static_entity_t static_entity) {
+                      return !this->has_entity(static_entity);
+                  });
+    return changed;
+}
+
+std::vector<static_entity_t> static_entities_t::destroyed_entities(
+    const uint64_t since_epoch) const {
+    // Entities created again are returned by changed_entities instead
+    auto destroyed = listed_after(this->destroyed_by_epoch, this->destroyed_epochs, since_epoch);
+    std::erase_if(destroyed,
+                  [this](const static_entity_t static_entity) {
+                      return this->has_entity(static_entity);
+                  });
+    return destroyed;
+}
+
+void static_entities_t::prune_epochs(const uint64_t until_epoch) {
+    prune_lists(this->changed_by_epoch, this->entity_epochs, until_epoch);
+    prune_lists(this->destroyed_by_epoch, this->destroyed_epochs, until_epoch);
+}
@@ -0,0 +1,119 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#include "ecs_history/tracing.hpp"
+
+#ifdef ECS_HISTORY_TRACING
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace ecs_history;
+
+namespace {
+struct buffers_t {
+    std::mutex mutex;
+    // Kept after their threads exit, so their zones can still be exported
+    std::vector<std::shared_ptr<tracing::thread_buffer_t> > buffers;
+};
+
+buffers_t &buffers() {
+    static buffers_t buffers;
+    return buffers;
+}
+
+std::shared_ptr<tracing::thread_buffer_t> register_thread() {
+    auto buffer = std::make_shared<tracing::thread_buffer_t>();
+    auto &all = buffers();
+    std::lock_guard lock(all.mutex);
+    buffer->thread_id = static_cast<uint32_t>(all.buffers.size());
+    all.buffers.push_back(buffer);
+    return buffer;
+}
+
+void write_string(std::ostream &out, const char *value) {
+    out << '"';
+    for (; *value != '\0'; ++value) {
+        if (*value == '"' || *value == '\\') {
+            out << '\\';
+        }
+        out << *value;
+    }
+    out << '"';
+}
+
+/**
+ * Microseconds with three decimals, as the default precision of streams loses the digits that matter.
+ */
+void write_us(std::ostream &out, const uint64_t ns) {
+    char digits[32];
+    std::snprintf(digits, sizeof(digits), "%llu.%03llu",
+                  static_cast<unsigned long long>(ns / 1000),
+                  static_cast<unsigned long long>(ns % 1000));
+    out << digits;
+}
+}
+
+tracing::thread_buffer_t &tracing::thread_buffer() {
+    thread_local const std::shared_ptr<thread_buffer_t> buffer = register_thread();
+    return *buffer;
+}
+
+uint64_t tracing::now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void tracing::write_chrome_trace(std::ostream &out) {
+    auto &all = buffers();
+    std::lock_guard lock(all.mutex);
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    for (const auto &buffer : all.buffers) {
+        const uint64_t head = buffer->head.load(std::memory_order_acquire);
+        const uint64_t begin = head - std::min<uint64_t>(head, thread_buffer_t::CAPACITY);
+        tracing::zone_event_t event{};
+        for (uint64_t i = begin; i < head; ++i) {
+            if (!buffer->read(i, event)) {
+                continue;
+            }
+            out << (first ? "\n" : ",\n") << "{\"name\":";
+            write_string(out, event.name);
+            out << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->thread_id
+                << ",\"ts\":";
+            write_us(out, event.start_ns);
+            out << ",\"dur\":";
+            write_us(out, event.end_ns - event.start_ns);
+            out << ",\"args\":{\"count\":" << event.count << ",\"bytes\":" << event.bytes << "}}";
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+}
+
+void tracing::clear() {
+    auto &all = buffers();
+    std::lock_guard lock(all.mutex);
+    for (const auto &buffer : all.buffers) {
+        buffer->head.store(0, std::memory_order_release);
+        for (auto &slot : buffer->slots) {
+            slot.sequence.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+#else
+
+void ecs_history::tracing::write_chrome_trace(std::ostream &out) {
+    out << "{\"traceEvents\":[]}\n";
+}
+
+void ecs_history::tracing::clear() {
+}
+
+#endif
@@ -0,0 +1,103 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#include "ecs_history/workload_recorder.hpp"
+#include "ecs_history/serialization/session.hpp"
+
+using namespace ecs_history;
+
+workload_recorder_t::workload_recorder_t(std::ostream &out)
+    : out(out), archive(out), scratch_archive(scratch) {
+    this->archive(WORKLOAD_MAGIC, WORKLOAD_VERSION);
+}
+
+workload_recorder_t::~workload_recorder_t() {
+    for (const auto &disconnect : this->disconnects) {
+        disconnect();
+    }
+    this->out.flush();
+}
+
+uint32_t workload_recorder_t::type_index(const entt::id_type id,
+                                         const size_t size,
+                                         const bool serialized) {
+    const auto [it, inserted] = this->type_indices.try_emplace(
+        id,
+        static_cast<uint32_t>(this->type_indices.size()));
+    if (inserted) {
+        this->archive(static_cast<uint8_t>(workload_event_type_t::TYPE),
+                      id,
+                      static_cast<uint32_t>(size),
+                      static_cast<uint8_t>(serialized));
+    }
+    return it->second;
+}
+
+void workload_recorder_t::write_event(const workload_event_type_t type,
+                                      const uint32_t component,
+                                      const entt::entity entity) {
+    this->archive(static_cast<uint8_t>(type));
+    serialization::write_varint(this->archive, component);
+    serialization::write_varint(this->archive, static_cast<uint32_t>(entt::to_integral(entity)));
+    this->event_count++;
+}
+
+void workload_recorder_t::write_value(const std::string_view bytes) {
+    serialization::write_varint(this->archive, static_cast<uint32_t>(bytes.size()));
+    this->archive(cereal::binary_data(bytes.data(), bytes.size()));
+}
+
+void workload_recorder_t::commit() {
+    this->archive(static_cast<uint8_t>(workload_event_type_t::COMMIT));
+    this->commit_count++;
+}
+
+workload_reader_t::workload_reader_t(std::istream &in) : in(in), archive(in) {
+    uint32_t magic;
+    this->archive(magic, this->version);
+    if (magic != WORKLOAD_MAGIC) {
+        throw std::runtime_error("Data is not a workload trace");
+    }
+    if (this->version == 0 || this->version > WORKLOAD_VERSION) {
+        throw std::runtime_error("Unsupported workload trace version");
+    }
+}
+
+std::optional<workload_event_t> workload_reader_t::next() {
+    while (this->in.peek() != std::char_traits<char>::eof()) {
+        uint8_t tag;
+        this->archive(tag);
+        const auto type = static_cast<workload_event_type_t>(tag);
+        if (type == workload_event_type_t::TYPE) {
+            workload_type_t component_type{};
+            this->archive(component_type.id, component_type.size);
+            component_type.serialized = true;
+            if (this->version >= 2) {
+                uint8_t serialized;
+                this->archive(serialized);
+                component_type.serialized = serialized != 0;
+            }
+            this->component_types.push_back(component_type);
+            continue;
+        }
+        workload_event_t event{type, 0, 0, {}};
+        if (type == workload_event_type_t::COMMIT) {
+            return event;
+        }
+        if (type > workload_event_type_t::COMMIT) {
+            throw std::runtime_error("Invalid record in workload trace");
+        }
+        event.component = serialization::read_varint(this->archive);
+        event.entity = serialization::read_varint(this->archive);
+        if (event.component >= this->component_types.size()) {
+            throw std::runtime_error("Workload trace references unknown type");
+        }
+        if (type != workload_event_type_t::DESTRUCT) {
+            event.value.resize(serialization::read_varint(this->archive));
+            this->archive(cereal::binary_data(event.value.data(), event.value.size()));
+        }
+        return event;
+    }
+    return std::nullopt;
+}
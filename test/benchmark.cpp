@@ -0,0 +1,650 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#include "ecs_history/serialization/serialization.hpp"
+#include "ecs_history/serialization/snapshot.hpp"
+#include "ecs_history/history.hpp"
+#include "ecs_history/concurrent_storage_monitor.hpp"
+#include "ecs_history/component/default_component.hpp"
+#include "ecs_history/entt/change_mixin.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using std::chrono::steady_clock;
+
+static std::atomic<size_t> allocation_count{0};
+
+void *operator new(const std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+constexpr size_t MAX_COMPONENT_TYPES = 8;
+
+template<size_t Size, size_t Index>
+struct payload_t {
+    std::array<uint8_t, Size> bytes{};
+};
+
+template<size_t Size, size_t Index>
+struct entt::storage_type<payload_t<Size, Index> > {
+    /*! @brief Type-to-storage conversion result. */
+    using type = change_storage_t<payload_t<Size, Index> >;
+};
+
+template<typename Archive, size_t Size, size_t Index>
+void serialize(Archive &archive, payload_t<Size, Index> &payload) {
+    archive(cereal::binary_data(payload.bytes.data(), Size));
+}
+
+struct benchmark_config_t {
+    uint32_t entities;
+    size_t component_size;
+    size_t component_types;
+    uint32_t construct_ratio;
+    uint32_t update_ratio;
+    uint32_t destruct_ratio;
+    double coalesce_ratio;
+    size_t history_depth;
+};
+
+struct sample_t {
+    double ms;
+    size_t bytes;
+    size_t allocations;
+    size_t changes;
+};
+
+class results_t {
+    std::vector<std::pair<std::string, std::vector<sample_t> > > results;
+
+public:
+    void add(const std::string &test, const sample_t sample) {
+        const auto it = std::ranges::find_if(results,
+                                             [&test](const auto &result) {
+                                                 return result.first == test;
+                                             });
+        if (it == results.end()) {
+            results.push_back({test, {sample}});
+        } else {
+            it->second.push_back(sample);
+        }
+    }
+
+    struct summary_t {
+        std::string test;
+        double median_ms;
+        double p90_ms;
+        double p99_ms;
+        double bytes_per_change;
+        double allocations_per_change;
+    };
+
+    [[nodiscard]] std::vector<summary_t> summarize() const {
+        std::vector<summary_t> summaries;
+        for (const auto &[test, samples] : results) {
+            std::vector<double> times;
+            size_t bytes = 0, allocations = 0, changes = 0;
+            for (const auto &sample : samples) {
+                times.push_back(sample.ms);
+                bytes += sample.bytes;
+                allocations += sample.allocations;
+                changes += sample.changes;
+            }
+            std::ranges::sort(times);
+            const auto percentile = [&times](const double p) {
+                const auto rank = static_cast<size_t>(std::ceil(p * times.size()));
+                return times[std::clamp<size_t>(rank, 1, times.size()) - 1];
+            };
+            const double per = changes == 0 ? 0.0 : 1.0 / changes;
+            summaries.push_back({test,
+                                 percentile(0.5),
+                                 percentile(0.9),
+                                 percentile(0.99),
+                                 bytes * per,
+                                 allocations * per});
+        }
+        return summaries;
+    }
+};
+
+/**
+ * One row per test with its median, keyed like performance.csv, so a run is one more version column.
+ */
+static void write_csv(std::ostream &os,
+                      const std::vector<results_t::summary_t> &summaries,
+                      const std::string &column) {
+    os << "test," << column << '\n';
+    for (const auto &s : summaries) {
+        os << s.test << ',' << s.median_ms << '\n';
+    }
+}
+
+static void write_json(std::ostream &os, const std::vector<results_t::summary_t> &summaries) {
+    os << "[\n";
+    for (size_t i = 0; i < summaries.size(); ++i) {
+        const auto &s = summaries[i];
+        os << "  {\"test\": \"" << s.test << "\", \"median_ms\": " << s.median_ms
+            << ", \"p90_ms\": " << s.p90_ms << ", \"p99_ms\": " << s.p99_ms
+            << ", \"bytes_per_change\": " << s.bytes_per_change
+            << ", \"allocations_per_change\": " << s.allocations_per_change << "}"
+            << (i + 1 < summaries.size() ? ",\n" : "\n");
+    }
+    os << "]\n";
+}
+
+template<typename Func>
+sample_t measure(Func &&func) {
+    const size_t allocations_before = allocation_count.load(std::memory_order_relaxed);
+    const auto start = steady_clock::now();
+    func();
+    const auto elapsed = steady_clock::now() - start;
+    return {std::chrono::duration<double, std::milli>(elapsed).count(),
+            0,
+            allocation_count.load(std::memory_order_relaxed) - allocations_before,
+            0};
+}
+
+static size_t count_changes(const ecs_history::commit_t &commit) {
+    size_t count = 0;
+    for (const auto &change_set : commit.change_sets) {
+        count += change_set->count();
+    }
+    return count;
+}
+
+/**
+ * Formats counts like performance.csv, e.g. 1.000.000
+ */
+static std::string format_count(const size_t count) {
+    std::string digits = std::to_string(count);
+    for (auto i = static_cast<std::ptrdiff_t>(digits.size()) - 3; i > 0; i -= 3) {
+        digits.insert(static_cast<size_t>(i), ".");
+    }
+    return digits;
+}
+
+template<size_t Size, size_t... Is>
+class scenario_t {
+    const benchmark_config_t &config;
+    results_t &results;
+    // Parameters a test depends on, so repeated runs of other configurations add samples to it
+    std::string sized;
+    std::string mixed;
+    std::string rebased;
+    std::string components;
+    std::mt19937 rng{42};
+
+    entt::registry reg;
+    ecs_history::static_entities_t &entities = reg.ctx().emplace<ecs_history::static_entities_t>();
+    std::vector<std::unique_ptr<ecs_history::base_storage_monitor_t> > monitors;
+    std::vector<entt::entity> sender_entities;
+
+    entt::registry reg2;
+    ecs_history::static_entities_t &entities2 = reg2.ctx().emplace<
+        ecs_history::static_entities_t>();
+    std::vector<std::unique_ptr<ecs_history::base_storage_monitor_t> > monitors2;
+    ecs_history::history_t history2{reg2, monitors2};
+
+    ecs_history::registry::component_registry_t component_registry;
+    ecs_history::commit_id_generator_t id_generator;
+    ecs_history::commit_id last_id = ecs_history::FIRST_BASE_ID;
+
+    template<typename Func>
+    bool with_type(const size_t type, Func &&func) {
+        return ((type == Is && (func.template operator()<payload_t<Size, Is> >(), true)) || ...);
+    }
+
+    template<typename Func>
+    void for_types(Func &&func) {
+        for (size_t type = 0; type < config.component_types; ++type) {
+            with_type(type, func);
+        }
+    }
+
+    /**
+     * @param phase Describes the changes, e.g. "with 1 created component each"
+     * @param tag Parameters the phase depends on
+     */
+    void pipeline(const std::string &phase, const std::string &tag) {
+        const std::string entities_of = " of " + format_count(config.entities) + " Entities " + phase + tag;
+        std::unique_ptr<ecs_history::commit_t> commit;
+        auto create_sample = measure([&] {
+            commit = ecs_history::create_commit(monitors, entities);
+        });
+        const size_t changes = count_changes(*commit);
+        create_sample.changes = changes;
+        results.add("Creating commit" + entities_of, create_sample);
+
+        std::string bytes;
+        auto serialize_sample = measure([&] {
+            std::stringstream oss{};
+            cereal::PortableBinaryOutputArchive archive(oss);
+            ecs_history::serialization::serialize_commit(archive, *commit);
+            bytes = oss.str();
+        });
+        serialize_sample.changes = changes;
+        serialize_sample.bytes = bytes.size();
+        results.add("Serializing commit" + entities_of, serialize_sample);
+
+        std::unique_ptr<ecs_history::commit_t> received;
+        auto deserialize_sample = measure([&] {
+            std::istringstream iss(bytes);
+            cereal::PortableBinaryInputArchive archive(iss);
+            received = ecs_history::serialization::deserialize_commit(archive, component_registry);
+        });
+        deserialize_sample.changes = changes;
+        deserialize_sample.bytes = bytes.size();
+        results.add("Deserializing commit" + entities_of, deserialize_sample);
+
+        const auto id = id_generator.next();
+        auto apply_sample = measure([&] {
+            history2.apply_commit(last_id, id, received);
+        });
+        apply_sample.changes = changes;
+        results.add("Applying commit" + entities_of, apply_sample);
+        last_id = id;
+    }
+
+    void construct_phase() {
+        auto sample = measure([&] {
+            for (uint32_t i = 0; i < config.entities; ++i) {
+                const auto entt = entities.create();
+                sender_entities.push_back(entt);
+                for_types([&]<typename T>() {
+                    reg.storage<T>().emplace(entt);
+                });
+            }
+        });
+        sample.changes = static_cast<size_t>(config.entities) * config.component_types;
+        results.add("Adding " + components + " to " + format_count(config.entities) + " Entities" +
+                    sized,
+                    sample);
+        pipeline("with " + components + " created each", sized);
+    }
+
+    void snapshot_phase() {
+        const std::string of = " of " + format_count(config.entities) + " Entities with " + components +
+                               sized;
+        const size_t values = static_cast<size_t>(config.entities) * config.component_types;
+        std::string snapshot;
+        auto write_sample = measure([&] {
+            snapshot = ecs_history::serialization::serialize_snapshot(reg, component_registry);
+        });
+        write_sample.changes = values;
+        write_sample.bytes = snapshot.size();
+        results.add("Writing snapshot" + of, write_sample);
+
+        entt::registry loaded;
+        loaded.ctx().emplace<ecs_history::static_entities_t>();
+        auto load_sample = measure([&] {
+            ecs_history::serialization::deserialize_snapshot(snapshot, loaded, component_registry);
+        });
+        load_sample.changes = values;
+        load_sample.bytes = snapshot.size();
+        results.add("Loading snapshot" + of, load_sample);
+    }
+
+    void mix_phase() {
+        const uint32_t total = config.construct_ratio + config.update_ratio + config.
+                               destruct_ratio;
+        std::uniform_int_distribution<uint32_t> op_dist(0, std::max(total, 1u) - 1);
+        std::uniform_real_distribution<double> coalesce_dist(0.0, 1.0);
+        std::vector<std::pair<entt::entity, size_t> > updated;
+        size_t ops = 0;
+
+        auto sample = measure([&] {
+            const size_t count = sender_entities.size();
+            for (size_t i = 0; i < count; ++i) {
+                auto entity = sender_entities[i];
+                auto type = i % config.component_types;
+                const uint32_t op = op_dist(rng);
+                if (op < config.construct_ratio) {
+                    const auto created = entities.create();
+                    sender_entities.push_back(created);
+                    with_type(type,
+                              [&]<typename T>() {
+                                  reg.storage<T>().emplace(created);
+                              });
+                    ++ops;
+                } else if (op < config.construct_ratio + config.update_ratio) {
+                    if (!updated.empty() && coalesce_dist(rng) < config.coalesce_ratio) {
+                        std::tie(entity, type) = updated[rng() % updated.size()];
+                    }
+                    with_type(type,
+                              [&]<typename T>() {
+                                  if (auto &storage = reg.storage<T>(); storage.
+                                      contains(entity)) {
+                                      storage.patch(entity,
+                                                    [](T &value) {
+                                                        ++value.bytes[0];
+                                                    });
+                                      updated.emplace_back(entity, type);
+                                      ++ops;
+                                  }
+                              });
+                } else {
+                    with_type(type,
+                              [&]<typename T>() {
+                                  if (auto &storage = reg.storage<T>(); storage.
+                                      contains(entity)) {
+                                      storage.remove(entity);
+                                      ++ops;
+                                  }
+                              });
+                }
+            }
+        });
+        sample.changes = ops;
+        results.add("Changing " + format_count(config.entities) + " Entities" + mixed, sample);
+        pipeline("changed", mixed);
+    }
+
+    void rebase_phase() {
+        if (config.history_depth == 0) {
+            return;
+        }
+        using first_t = payload_t<Size, 0>;
+        auto &storage = reg.storage<first_t>();
+        auto &storage2 = reg2.storage<first_t>();
+
+        std::vector<ecs_history::static_entity_t> alive;
+        for (const auto entt : sender_entities) {
+            if (storage.contains(entt)) {
+                alive.push_back(entities.get_static_entity(entt));
+            }
+        }
+        const size_t touched = std::min<size_t>(64, alive.size() / 2);
+        if (touched == 0) {
+            return;
+        }
+
+        // Local commits on the receiver touch the first entities,
+        // the remote commit touches the last ones, so all local commits can be rebased.
+        const auto base_id = last_id;
+        for (size_t depth = 0; depth < config.history_depth; ++depth) {
+            for (size_t i = 0; i < touched; ++i) {
+                storage2.patch(entities2.get_entity(alive[i]),
+                               [](first_t &value) {
+                                   ++value.bytes[0];
+                               });
+            }
+            auto local = ecs_history::create_commit(monitors2, entities2);
+            last_id = id_generator.next();
+            history2.add_commit(last_id, local);
+        }
+
+        for (size_t i = alive.size() - touched; i < alive.size(); ++i) {
+            storage.patch(entities.get_entity(alive[i]),
+                          [](first_t &value) {
+                              ++value.bytes[0];
+                          });
+        }
+        auto remote = ecs_history::create_commit(monitors, entities);
+        auto sample = measure([&] {
+            history2.apply_commit(base_id, id_generator.next(), remote);
+        });
+        sample.changes = touched * (config.history_depth + 1);
+        results.add("Rebasing " + std::to_string(config.history_depth) + " commits of " +
+                    std::to_string(touched) + " changes over a commit" + rebased,
+                    sample);
+    }
+
+public:
+    scenario_t(const benchmark_config_t &config, results_t &results)
+        : config(config),
+          results(results) {
+        components = std::to_string(config.component_types) +
+                     (config.component_types == 1 ? " component" : " components");
+        std::ostringstream tag;
+        tag << " (" << Size << " B";
+        sized = tag.str() + ")";
+        tag << ", mix " << config.construct_ratio << ':' << config.update_ratio << ':'
+            << config.destruct_ratio << ", coalesce " << config.coalesce_ratio;
+        mixed = tag.str() + ")";
+        // The rebase follows the mix phase
+        tag << ", depth " << config.history_depth;
+        rebased = tag.str() + ")";
+
+        for_types([&]<typename T>() {
+            monitors.push_back(std::make_unique<ecs_history::storage_monitor_t<T> >(
+                entities,
+                reg.storage<T>()));
+            monitors2.push_back(std::make_unique<ecs_history::storage_monitor_t<T> >(
+                entities2,
+                reg2.storage<T>()));
+            std::unique_ptr<ecs_history::registry::component_t> component = std::make_unique<
+                ecs_history::default_component_t<T> >();
+            component_registry.register_component<T>(component);
+        });
+    }
+
+    void run() {
+        construct_phase();
+        snapshot_phase();
+        mix_phase();
+        rebase_phase();
+    }
+};
+
+template<size_t Size>
+void run_sized(const benchmark_config_t &config, results_t &results) {
+    [&]<size_t... Is>(std::index_sequence<Is...>) {
+        scenario_t<Size, Is...> scenario{config, results};
+        scenario.run();
+    }(std::make_index_sequence<MAX_COMPONENT_TYPES>{});
+}
+
+static void run(const benchmark_config_t &config, results_t &results) {
+    switch (config.component_size) {
+    case 4: return run_sized<4>(config, results);
+    case 16: return run_sized<16>(config, results);
+    case 64: return run_sized<64>(config, results);
+    case 256: return run_sized<256>(config, results);
+    case 1024: return run_sized<1024>(config, results);
+    default:
+        throw std::runtime_error("Unsupported component size (4, 16, 64, 256 or 1024)");
+    }
+}
+
+/**
+ * Patches every entity once, split evenly over the workers, and commits the recorded changes.
+ */
+template<size_t Size>
+void run_concurrent(const uint32_t entity_count, const size_t workers, results_t &results) {
+    using component_t = payload_t<Size, 0>;
+    entt::registry reg;
+    auto &entities = reg.ctx().emplace<ecs_history::static_entities_t>();
+    auto &storage = reg.storage<component_t>();
+    std::vector<std::unique_ptr<ecs_history::base_storage_monitor_t> > monitors;
+    monitors.push_back(std::make_unique<ecs_history::concurrent_storage_monitor_t<component_t> >(
+        entities,
+        storage,
+        workers));
+    std::vector<entt::entity> created;
+    created.reserve(entity_count);
+    for (uint32_t i = 0; i < entity_count; ++i) {
+        created.push_back(entities.create());
+        storage.emplace(created.back());
+    }
+    ecs_history::create_commit(monitors, entities);
+
+    const std::string tag = " of " + format_count(entity_count) + " Entities on " +
+                            std::to_string(workers) + " workers (" + std::to_string(Size) + " B)";
+    auto record_sample = measure([&] {
+        std::vector<std::thread> threads;
+        for (size_t worker = 0; worker < workers; ++worker) {
+            threads.emplace_back([&, worker] {
+                ecs_history::set_worker_index(worker);
+                const size_t begin = created.size() * worker / workers;
+                const size_t end = created.size() * (worker + 1) / workers;
+                for (size_t i = begin; i < end; ++i) {
+                    storage.patch(created[i],
+                                  [](component_t &value) {
+                                      ++value.bytes[0];
+                                  });
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+    });
+    record_sample.changes = entity_count;
+    results.add("Recording updates" + tag, record_sample);
+
+    auto commit_sample = measure([&] {
+        ecs_history::create_commit(monitors, entities);
+    });
+    commit_sample.changes = entity_count;
+    results.add("Creating concurrent commit" + tag, commit_sample);
+}
+
+template<typename T>
+static std::vector<T> parse_list(const std::string &arg) {
+    std::vector<T> values;
+    std::istringstream iss(arg);
+    std::string token;
+    while (std::getline(iss, token, ',')) {
+        std::istringstream token_stream(token);
+        T value;
+        token_stream >> value;
+        values.push_back(value);
+    }
+    return values;
+}
+
+static std::array<uint32_t, 3> parse_mix(const std::string &arg) {
+    std::array<uint32_t, 3> mix{};
+    std::istringstream iss(arg);
+    std::string token;
+    for (auto &ratio : mix) {
+        if (!std::getline(iss, token, ':')) {
+            throw std::runtime_error("Change mix has to be construct:update:destruct");
+        }
+        ratio = std::stoul(token);
+    }
+    return mix;
+}
+
+int main(const int argc, char **argv) {
+    spdlog::set_level(spdlog::level::warn);
+
+    std::vector<uint32_t> entity_counts{100000};
+    std::vector<size_t> sizes{4, 16, 64, 256, 1024};
+    std::vector<size_t> type_counts{1, 4};
+    std::vector<std::array<uint32_t, 3> > mixes{{10, 80, 10}};
+    std::vector<double> coalesce_ratios{0.0, 0.5};
+    std::vector<size_t> depths{0, 8};
+    std::vector<size_t> worker_counts{1, 2, 4};
+    size_t repeat = 5;
+    std::string format = "csv";
+    std::string column = "v4";
+    std::string out;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string arg = argv[i];
+        const std::string value = argv[i + 1];
+        if (arg == "--entities") {
+            entity_counts = parse_list<uint32_t>(value);
+        } else if (arg == "--sizes") {
+            sizes = parse_list<size_t>(value);
+        } else if (arg == "--types") {
+            type_counts = parse_list<size_t>(value);
+        } else if (arg == "--mix") {
+            mixes.clear();
+            for (const auto &mix : parse_list<std::string>(value)) {
+                mixes.push_back(parse_mix(mix));
+            }
+        } else if (arg == "--coalesce") {
+            coalesce_ratios = parse_list<double>(value);
+        } else if (arg == "--depth") {
+            depths = parse_list<size_t>(value);
+        } else if (arg == "--workers") {
+            worker_counts = parse_list<size_t>(value);
+        } else if (arg == "--repeat") {
+            repeat = std::stoul(value);
+        } else if (arg == "--format") {
+            format = value;
+        } else if (arg == "--column") {
+            column = value;
+        } else if (arg == "--out") {
+            out = value;
+        } else {
+            std::cerr << "unknown argument " << arg << '\n';
+            return 1;
+        }
+    }
+
+    results_t results;
+    for (const auto entity_count : entity_counts) {
+        for (const auto size : sizes) {
+            for (const auto types : type_counts) {
+                for (const auto &mix : mixes) {
+                    for (const auto coalesce : coalesce_ratios) {
+                        for (const auto depth : depths) {
+                            const benchmark_config_t config{
+                                entity_count,
+                                size,
+                                std::clamp<size_t>(types, 1, MAX_COMPONENT_TYPES),
+                                mix[0],
+                                mix[1],
+                                mix[2],
+                                coalesce,
+                                depth
+                            };
+                            for (size_t r = 0; r < repeat; ++r) {
+                                run(config, results);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Scaling of concurrent recording, one component of 16 B
+    for (const auto entity_count : entity_counts) {
+        for (const auto workers : worker_counts) {
+            for (size_t r = 0; r < repeat; ++r) {
+                run_concurrent<16>(entity_count, std::max<size_t>(workers, 1), results);
+            }
+        }
+    }
+
+    const auto summaries = results.summarize();
+    std::ofstream file;
+    if (!out.empty()) {
+        file.open(out);
+    }
+    std::ostream &os = out.empty() ? std::cout : file;
+    if (format == "json") {
+        write_json(os, summaries);
+    } else {
+        write_csv(os, summaries, column);
+    }
+
+    return 0;
+}
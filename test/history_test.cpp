@@ -3,12 +3,23 @@
 //
 
 #include "ecs_history/serialization/serialization.hpp"
+#include "ecs_history/serialization/interest.hpp"
+#include "ecs_history/serialization/snapshot.hpp"
+#include "ecs_history/serialization/session.hpp"
 #include "ecs_history/history.hpp"
+#include "ecs_history/incremental_apply.hpp"
+#include "ecs_history/join_service.hpp"
+#include "ecs_history/concurrent_storage_monitor.hpp"
+#include "ecs_history/commit_pipeline.hpp"
 #include "ecs_history/component/default_component.hpp"
 #include "ecs_history/entt/change_mixin.hpp"
 
 #include <spdlog/stopwatch.h>
 
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
 using namespace entt::literals;
 using std::chrono::duration_cast;
 using std::chrono::milliseconds;
@@ -28,9 +39,162 @@ void serialize(Archive &archive, bounding_box_t &box) {
     archive(box.value);
 }
 
-int main() {
-    spdlog::set_level(spdlog::level::info);
+struct health_t {
+    uint16_t value;
+};
+
+template<>
+struct entt::storage_type<health_t> {
+    /*! @brief Type-to-storage conversion result. */
+    using type = change_storage_t<health_t>;
+};
+
+template<typename Archive>
+void serialize(Archive &archive, health_t &health) {
+    archive(health.value);
+}
+
+template<>
+struct ecs_history::drop_noop_updates_t<health_t> : std::true_type {
+};
+
+/**
+ * Has padding between its members, so snapshots must not copy it as it is in memory.
+ */
+struct velocity_t {
+    uint8_t axis;
+    uint32_t speed;
+};
+
+template<>
+struct entt::storage_type<velocity_t> {
+    /*! @brief Type-to-storage conversion result. */
+    using type = change_storage_t<velocity_t>;
+};
+
+template<typename Archive>
+void serialize(Archive &archive, velocity_t &velocity) {
+    archive(velocity.axis, velocity.speed);
+}
+
+/**
+ * Sent with a lossy codec, so the receiver has different values than the sender.
+ */
+struct position_t {
+    float x;
+    float y;
+};
+
+template<>
+struct entt::storage_type<position_t> {
+    /*! @brief Type-to-storage conversion result. */
+    using type = change_storage_t<position_t>;
+};
+
+template<>
+struct ecs_history::codec_traits_t<position_t> {
+    using type = codec::struct_t<position_t,
+                                 codec::member_t<&position_t::x, codec::quantized_t<-100.f, 100.f, 12> >,
+                                 codec::member_t<&position_t::y, codec::half_t> >;
+};
+
+template<typename Archive>
+void serialize(Archive &archive, position_t &position) {
+    archive(position.x, position.y);
+}
+
+struct mesh_t {
+    std::vector<uint8_t> vertices;
+};
+
+template<>
+struct ecs_history::shared_payload_t<mesh_t> : std::true_type {
+};
+
+template<>
+struct ecs_history::memory::heap_usage_t<mesh_t> {
+    static size_t of(const mesh_t &mesh) {
+        return heap_usage(mesh.vertices);
+    }
+};
+
+struct rotation_t {
+    float x;
+    float y;
+    float z;
+    float w;
+};
+
+using monitors_t = std::vector<std::unique_ptr<ecs_history::base_storage_monitor_t> >;
+
+/**
+ * Registry with its static entities and the monitors of its storages.
+ */
+struct world_t {
+    entt::registry reg;
+    ecs_history::static_entities_t &entities = reg.ctx().emplace<ecs_history::static_entities_t>();
+    monitors_t monitors;
+
+    template<typename T>
+    entt::storage_type_t<T> &monitor() {
+        auto &storage = reg.storage<T>();
+        monitors.push_back(std::make_unique<ecs_history::storage_monitor_t<T> >(entities, storage));
+        return storage;
+    }
+
+    template<typename T>
+    entt::storage_type_t<T> &monitor_concurrently(const size_t workers) {
+        auto &storage = reg.storage<T>();
+        monitors.push_back(std::make_unique<ecs_history::concurrent_storage_monitor_t<T> >(
+            entities,
+            storage,
+            workers));
+        return storage;
+    }
+};
+
+static ecs_history::registry::component_registry_t &component_registry() {
+    static ecs_history::registry::component_registry_t registry = [] {
+        ecs_history::registry::component_registry_t components;
+        std::unique_ptr<ecs_history::registry::component_t> box = std::make_unique<
+            ecs_history::default_component_t<bounding_box_t> >();
+        components.register_component<bounding_box_t>(box);
+        std::unique_ptr<ecs_history::registry::component_t> health = std::make_unique<
+            ecs_history::default_component_t<health_t> >();
+        components.register_component<health_t>(health);
+        std::unique_ptr<ecs_history::registry::component_t> velocity = std::make_unique<
+            ecs_history::default_component_t<velocity_t> >();
+        components.register_component<velocity_t>(velocity);
+        std::unique_ptr<ecs_history::registry::component_t> position = std::make_unique<
+            ecs_history::default_component_t<position_t> >();
+        components.register_component<position_t>(position);
+        return components;
+    }();
+    return registry;
+}
 
+/**
+ * Deserializes a commit received from another peer.
+ */
+static std::unique_ptr<ecs_history::commit_t> receive(const std::string &bytes) {
+    std::istringstream stream(bytes);
+    cereal::PortableBinaryInputArchive archive(stream);
+    return ecs_history::serialization::deserialize_commit(archive, component_registry());
+}
+
+/**
+ * Serializes and deserializes a commit, as sending it to another peer does.
+ */
+static std::unique_ptr<ecs_history::commit_t> transmit(const ecs_history::commit_t &commit) {
+    std::ostringstream stream;
+    {
+        cereal::PortableBinaryOutputArchive archive(stream);
+        ecs_history::serialization::serialize_commit(archive, commit);
+    }
+    return receive(std::move(stream).str());
+}
+
+static void test_sequential_commits() {
     std::unique_ptr<ecs_history::registry::component_t> component = std::make_unique<
         ecs_history::default_component_t<bounding_box_t> >();
     ecs_history::registry::component_registry_t registry;
@@ -64,6 +228,970 @@ int main() {
 
     assert(entities.get_versions().size() == 2);
     assert(entities2.get_versions().size() == 2);
+}
+
+/**
+ * Entities created by applying a commit get the version after the commit,
+ * otherwise the next commit of the sender is rejected by can_apply_commit.
+ */
+static void test_created_entity_versions() {
+    world_t sender;
+    auto &storage = sender.monitor<bounding_box_t>();
+    world_t receiver;
+    receiver.monitor<bounding_box_t>();
+
+    const auto entity = sender.entities.create();
+    storage.emplace(entity, bounding_box_t{1});
+    const auto created = ecs_history::create_commit(sender.monitors, sender.entities);
+    ecs_history::apply_commit(receiver.reg, receiver.monitors, *transmit(*created));
+
+    const auto static_entity = sender.entities.get_static_entity(entity);
+    assert(receiver.entities.get_version(static_entity) == sender.entities.get_version(static_entity));
+
+    storage.patch(entity, [](bounding_box_t &box) { box.value = 2; });
+    const auto updated = transmit(*ecs_history::create_commit(sender.monitors, sender.entities));
+    assert(ecs_history::can_apply_commit(receiver.reg, *updated));
+    ecs_history::apply_commit(receiver.reg, receiver.monitors, *updated);
+    assert(receiver.entities.get_version(static_entity) == sender.entities.get_version(static_entity));
+}
+
+/**
+ * Removing the only component of an entity and emplacing it again records [-1, +1],
+ * which must not release the entity before the reference is added back.
+ */
+static void test_concurrent_readd_last_component() {
+    world_t sender;
+    auto &storage = sender.monitor_concurrently<bounding_box_t>(2);
+    const auto entity = sender.entities.create();
+    storage.emplace(entity, bounding_box_t{1});
+    ecs_history::create_commit(sender.monitors, sender.entities);
+    const auto static_entity = sender.entities.get_static_entity(entity);
+
+    storage.remove(entity);
+    storage.emplace(entity, bounding_box_t{2});
+    const auto commit = ecs_history::create_commit(sender.monitors, sender.entities);
+    assert(sender.entities.has_entity(static_entity));
+    assert(commit->destroyed_entities.empty());
+
+    // The same split over two workers
+    ecs_history::set_worker_index(0);
+    storage.remove(entity);
+    ecs_history::set_worker_index(1);
+    storage.emplace(entity, bounding_box_t{3});
+    ecs_history::set_worker_index(0);
+    const auto split = ecs_history::create_commit(sender.monitors, sender.entities);
+    assert(sender.entities.has_entity(static_entity));
+    assert(split->change_sets[0]->is_destruct(0));
+    assert(!split->change_sets[0]->is_destruct(1));
+}
+
+/**
+ * Buffers are merged in the order changes were recorded, not in worker order.
+ */
+static void test_concurrent_worker_order() {
+    world_t sender;
+    auto &storage = sender.monitor_concurrently<bounding_box_t>(2);
+    world_t receiver;
+    receiver.monitor<bounding_box_t>();
+    const auto entity = sender.entities.create();
+    const auto static_entity = sender.entities.get_static_entity(entity);
+
+    ecs_history::set_worker_index(1);
+    storage.emplace(entity, bounding_box_t{1});
+    ecs_history::set_worker_index(0);
+    storage.remove(entity);
+    const auto commit = ecs_history::create_commit(sender.monitors, sender.entities);
+
+    const auto &change_set = *commit->change_sets[0];
+    assert(change_set.count() == 2);
+    assert(!change_set.is_destruct(0));
+    assert(change_set.is_destruct(1));
+    assert(!sender.entities.has_entity(static_entity));
+
+    ecs_history::apply_commit(receiver.reg, receiver.monitors, *transmit(*commit));
+    assert(!receiver.entities.has_entity(static_entity));
+
+    // Updates of one entity passed from worker to worker
+    const auto other = sender.entities.create();
+    storage.emplace(other, bounding_box_t{1});
+    ecs_history::apply_commit(receiver.reg,
+                              receiver.monitors,
+                              *transmit(*ecs_history::create_commit(sender.monitors, sender.entities)));
+    for (uint8_t value = 2; value < 6; ++value) {
+        ecs_history::set_worker_index(value % 2);
+        storage.patch(other, [value](bounding_box_t &box) { box.value = value; });
+    }
+    ecs_history::set_worker_index(0);
+    const auto updates = ecs_history::create_commit(sender.monitors, sender.entities);
+    assert(updates->change_sets[0]->count() == 4);
+    ecs_history::apply_commit(receiver.reg, receiver.monitors, *transmit(*updates));
+    const auto received = receiver.entities.get_entity(sender.entities.get_static_entity(other));
+    assert(receiver.reg.get<bounding_box_t>(received).value == 5);
+}
+
+/**
+ * An entity losing its last component in one concurrent monitor and gaining one in another
+ * survives, whichever monitor commits first.
+ */
+static void test_concurrent_monitors_share_entity() {
+    world_t sender;
+    auto &boxes = sender.monitor_concurrently<bounding_box_t>(1);
+    auto &healths = sender.monitor_concurrently<health_t>(1);
+    const auto entity = sender.entities.create();
+    boxes.emplace(entity, bounding_box_t{1});
+    ecs_history::create_commit(sender.monitors, sender.entities);
+    const auto static_entity = sender.entities.get_static_entity(entity);
+
+    boxes.remove(entity);
+    healths.emplace(entity, health_t{100});
+    const auto commit = ecs_history::create_commit(sender.monitors, sender.entities);
+    assert(sender.entities.has_entity(static_entity));
+    assert(commit->destroyed_entities.empty());
+
+    healths.remove(entity);
+    ecs_history::create_commit(sender.monitors, sender.entities);
+    assert(!sender.entities.has_entity(static_entity));
+}
+
+/**
+ * Commits are shipped in submit order, a pipeline nobody polls rejects try_submit
+ * once both queues and the worker are full, and destroying it ships the queued commits.
+ */
+static void test_commit_pipeline() {
+    ecs_history::commit_id_generator_t generator;
+    {
+        ecs_history::commit_pipeline_t pipeline{1};
+        std::vector<ecs_history::commit_id> submitted;
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (true) {
+            const auto id = generator.next();
+            if (!pipeline.try_submit(id, std::make_shared<const ecs_history::commit_t>())) {
+                break;
+            }
+            submitted.push_back(id);
+            assert(std::chrono::steady_clock::now() < deadline);
+        }
+        // One commit shipped, one held by the worker and one queued at most
+        assert(!submitted.empty() && submitted.size() <= 3);
+        for (const auto &id : submitted) {
+            const auto shipped = pipeline.wait();
+            assert(shipped.has_value() && shipped->id == id);
+        }
+        // Polling made room again
+        const auto id = generator.next();
+        pipeline.submit(id, std::make_shared<const ecs_history::commit_t>());
+        assert(pipeline.wait()->id == id);
+    }
+
+    std::atomic<size_t> completed{0};
+    {
+        ecs_history::commit_pipeline_t pipeline{8,
+                                                {},
+                                                [&completed](ecs_history::commit_id, size_t) {
+                                                    completed.fetch_add(1);
+                                                }};
+        for (int i = 0; i < 8; ++i) {
+            pipeline.submit(generator.next(), std::make_shared<const ecs_history::commit_t>());
+        }
+    }
+    assert(completed.load() == 8);
+}
+
+/**
+ * A filtered commit applies only the changes its filter selects, and subscribers with
+ * the same filter object or equal filters share one buffer.
+ */
+static void test_filtered_commit() {
+    world_t sender;
+    auto &boxes = sender.monitor<bounding_box_t>();
+    auto &healths = sender.monitor<health_t>();
+    const auto first = sender.entities.create();
+    const auto second = sender.entities.create();
+    boxes.emplace(first, bounding_box_t{1});
+    healths.emplace(first, health_t{100});
+    boxes.emplace(second, bounding_box_t{2});
+    const auto commit = ecs_history::create_commit(sender.monitors, sender.entities);
+    const auto first_static = sender.entities.get_static_entity(first);
+    const auto second_static = sender.entities.get_static_entity(second);
+
+    using filter_t = ecs_history::serialization::interest_filter_t;
+    const auto only_boxes = std::make_shared<const filter_t>(
+        filter_t{{entt::type_hash<bounding_box_t>::value()}, std::nullopt, {}});
+    const auto also_only_boxes = std::make_shared<const filter_t>(*only_boxes);
+    const auto only_first = std::make_shared<const filter_t>(
+        filter_t{{}, std::unordered_set{first_static}, {}});
+    const auto buffers = ecs_history::serialization::serialize_filtered_commit(
+        *commit,
+        {only_boxes, also_only_boxes, only_first, only_boxes});
+    assert(buffers.size() == 4);
+    assert(buffers[0] == buffers[1] && buffers[0] == buffers[3]);
+    assert(buffers[0] != buffers[2]);
+
+    world_t box_receiver;
+    box_receiver.monitor<bounding_box_t>();
+    box_receiver.monitor<health_t>();
+    ecs_history::apply_commit(box_receiver.reg, box_receiver.monitors, *receive(*buffers[0]));
+    const auto &received_boxes = box_receiver.reg.storage<bounding_box_t>();
+    assert(received_boxes.size() == 2);
+    assert(received_boxes.get(box_receiver.entities.get_entity(first_static)).value == 1);
+    assert(received_boxes.get(box_receiver.entities.get_entity(second_static)).value == 2);
+    assert(box_receiver.reg.storage<health_t>().empty());
+
+    world_t first_receiver;
+    first_receiver.monitor<bounding_box_t>();
+    first_receiver.monitor<health_t>();
+    ecs_history::apply_commit(first_receiver.reg, first_receiver.monitors, *receive(*buffers[2]));
+    assert(first_receiver.entities.has_entity(first_static));
+    assert(!first_receiver.entities.has_entity(second_static));
+    const auto received_first = first_receiver.entities.get_entity(first_static);
+    assert(first_receiver.reg.storage<bounding_box_t>().get(received_first).value == 1);
+    assert(first_receiver.reg.storage<health_t>().get(received_first).value == 100);
+    assert(first_receiver.entities.get_version(first_static) == sender.entities.get_version(first_static));
+
+    // Views list every destroyed entity they include
+    const auto only_health = std::make_shared<const filter_t>(
+        filter_t{{entt::type_hash<health_t>::value()}, std::nullopt, {}});
+    sender.reg.destroy(first);
+    sender.reg.destroy(second);
+    const auto despawned = ecs_history::create_commit(sender.monitors, sender.entities);
+    const auto despawn_buffers = ecs_history::serialization::serialize_filtered_commit(
+        *despawned,
+        {only_boxes, only_first, only_health});
+    const auto box_despawns = receive(*despawn_buffers[0]);
+    assert(box_despawns->destroyed_entities == despawned->destroyed_entities);
+    assert(receive(*despawn_buffers[1])->destroyed_entities == std::vector{first_static});
+    assert(receive(*despawn_buffers[2])->destroyed_entities == despawned->destroyed_entities);
+    ecs_history::apply_commit(box_receiver.reg, box_receiver.monitors, *box_despawns);
+    assert(!box_receiver.entities.has_entity(first_static) && !box_receiver.entities.has_entity(second_static));
+    assert(box_receiver.reg.storage<bounding_box_t>().empty());
+    ecs_history::apply_commit(first_receiver.reg, first_receiver.monitors, *receive(*despawn_buffers[1]));
+    assert(!first_receiver.entities.has_entity(first_static));
+    assert(first_receiver.reg.storage<health_t>().empty());
+}
+
+/**
+ * The cached encoding is reused until it is invalidated and follows the byte order of the archive.
+ */
+static void test_encoding_cache() {
+    world_t sender;
+    auto &boxes = sender.monitor<bounding_box_t>();
+    boxes.emplace(sender.entities.create(), bounding_box_t{1});
+    const auto commit = ecs_history::create_commit(sender.monitors, sender.entities);
+    const auto bytes = commit->encoded();
+    assert(commit->encoded() == bytes);
+
+    commit->checksum = 42;
+    assert(commit->encoded() == bytes);
+    commit->invalidate();
+    const auto mutated = commit->encoded();
+    assert(mutated != bytes);
+    assert(receive(*mutated)->checksum == 42);
+
+    std::ostringstream stream;
+    {
+        cereal::PortableBinaryOutputArchive archive(
+            stream,
+            cereal::PortableBinaryOutputArchive::Options::BigEndian());
+        ecs_history::serialization::serialize_commit(archive, *commit, std::endian::big);
+    }
+    const auto big_endian = receive(std::move(stream).str());
+    assert(big_endian->checksum == 42);
+    assert(big_endian->entity_versions == commit->entity_versions);
+    assert(big_endian->count() == 1);
+}
+
+/**
+ * Fills a world with boxes, healths and velocities whose padding bytes are set to padding.
+ */
+static void fill_snapshot_world(world_t &world, const uint8_t padding) {
+    for (uint8_t i = 0; i < 4; ++i) {
+        const auto entity = world.entities.create();
+        world.reg.emplace<bounding_box_t>(entity, bounding_box_t{i});
+        if (i % 2 == 0) {
+            world.reg.emplace<health_t>(entity, health_t{static_cast<uint16_t>(100 + i)});
+        }
+        velocity_t velocity;
+        std::memset(&velocity, padding, sizeof(velocity));
+        velocity.axis = i;
+        velocity.speed = 1000u * i;
+        world.reg.emplace<velocity_t>(entity, velocity);
+    }
+}
+
+/**
+ * A v2 snapshot restores entities, versions and values, and equal registries give equal
+ * snapshots even if the padding of their values differs.
+ */
+static void test_snapshot_round_trip() {
+    world_t sender;
+    fill_snapshot_world(sender, 0x00);
+    const auto snapshot = ecs_history::serialization::serialize_snapshot(sender.reg, component_registry());
+
+    world_t receiver;
+    ecs_history::serialization::deserialize_snapshot(snapshot, receiver.reg, component_registry());
+    assert(receiver.entities.get_versions() == sender.entities.get_versions());
+    for (const auto [entity, box] : sender.reg.view<bounding_box_t>().each()) {
+        const auto received = receiver.entities.get_entity(sender.entities.get_static_entity(entity));
+        assert(receiver.reg.get<bounding_box_t>(received).value == box.value);
+        assert(receiver.reg.all_of<health_t>(received) == sender.reg.all_of<health_t>(entity));
+        if (sender.reg.all_of<health_t>(entity)) {
+            assert(receiver.reg.get<health_t>(received).value == sender.reg.get<health_t>(entity).value);
+        }
+        const auto &velocity = sender.reg.get<velocity_t>(entity);
+        assert(receiver.reg.get<velocity_t>(received).axis == velocity.axis);
+        assert(receiver.reg.get<velocity_t>(received).speed == velocity.speed);
+    }
+
+    world_t padded;
+    fill_snapshot_world(padded, 0xff);
+    assert(ecs_history::serialization::serialize_snapshot(padded.reg, component_registry()) == snapshot);
+}
+
+/**
+ * Epoch queries return every entity once, for its last epoch, and forget pruned epochs.
+ */
+static void test_epoch_tracking() {
+    ecs_history::static_entities_t entities;
+    entities.set_epoch_tracking(true);
+    const auto first = entities.get_static_entity(entities.create());
+    const auto second = entities.get_static_entity(entities.create());
+    const auto epoch = entities.advance_epoch();
+    entities.set_version(second, 1);
+    entities.set_version(second, 2);
+    entities.destroy(first);
+
+    assert(entities.changed_entities(epoch) == std::vector{second});
+    assert(entities.destroyed_entities(epoch) == std::vector{first});
+    assert(entities.changed_entities(0) == std::vector{second});
+
+    entities.prune_epochs(epoch);
+    assert(entities.changed_entities(0) == std::vector{second});
+    assert(entities.destroyed_entities(0) == std::vector{first});
+    entities.prune_epochs(entities.advance_epoch());
+    assert(entities.changed_entities(0).empty());
+    assert(entities.destroyed_entities(0).empty());
+}
+
+/**
+ * value_at answers from the changes of the requested component and does not create storages
+ * for components the registry never had.
+ */
+static void test_value_at() {
+    world_t sender;
+    auto &boxes = sender.monitor<bounding_box_t>();
+    world_t receiver;
+    receiver.monitor<bounding_box_t>();
+    ecs_history::history_t history{receiver.reg, receiver.monitors};
+    ecs_history::commit_id_generator_t generator;
+
+    const auto entity = sender.entities.create();
+    const auto static_entity = sender.entities.get_static_entity(entity);
+    boxes.emplace(entity, bounding_box_t{1});
+    const auto created = generator.next();
+    auto commit = transmit(*ecs_history::create_commit(sender.monitors, sender.entities));
+    history.apply_commit(ecs_history::FIRST_BASE_ID, created, commit);
+    boxes.patch(entity, [](bounding_box_t &box) { box.value = 2; });
+    const auto updated = generator.next();
+    commit = transmit(*ecs_history::create_commit(sender.monitors, sender.entities));
+    history.apply_commit(created, updated, commit);
+
+    assert(history.value_at<bounding_box_t>(static_entity, created)->value == 1);
+    assert(history.value_at<bounding_box_t>(static_entity, updated)->value == 2);
+    assert(history.changes_of(static_entity).size() == 2);
+    assert(history.changes_of(static_entity, entt::type_hash<bounding_box_t>::value()).size() == 2);
+
+    assert(!history.value_at<health_t>(static_entity, updated).has_value());
+    assert(receiver.reg.storage(entt::type_hash<health_t>::value()) == nullptr);
+
+    // Commits added after the index was built by the first query are indexed right away
+    boxes.patch(entity, [](bounding_box_t &box) { box.value = 3; });
+    const auto patched = generator.next();
+    commit = transmit(*ecs_history::create_commit(sender.monitors, sender.entities));
+    history.apply_commit(updated, patched, commit);
+    assert(history.value_at<bounding_box_t>(static_entity, updated)->value == 2);
+    assert(history.value_at<bounding_box_t>(static_entity, patched)->value == 3);
+    assert(history.changes_of(static_entity).size() == 3);
+
+    // Received despawns do not carry destruct changes, the components removed on apply are indexed
+    sender.reg.destroy(entity);
+    const auto despawned = generator.next();
+    commit = transmit(*ecs_history::create_commit(sender.monitors, sender.entities));
+    history.apply_commit(patched, despawned, commit);
+    assert(!receiver.entities.has_entity(static_entity));
+    assert(!history.value_at<bounding_box_t>(static_entity, despawned).has_value());
+    assert(history.value_at<bounding_box_t>(static_entity, patched)->value == 3);
+    assert(history.changes_of(static_entity).size() == 4);
+}
+
+/**
+ * Encodes and decodes a value with a codec.
+ */
+template<typename Codec, typename T>
+static T codec_round_trip(const T &value) {
+    std::array<uint8_t, (Codec::bits + 7) / 8> bytes{};
+    ecs_history::codec::bit_writer_t writer{bytes.data()};
+    Codec::encode(writer, value);
+    ecs_history::codec::bit_reader_t reader{bytes.data()};
+    return Codec::decode(reader);
+}
+
+static void test_quantized_codec() {
+    using byte_t = ecs_history::codec::quantized_t<-1.f, 1.f, 8>;
+    assert(codec_round_trip<byte_t>(-1.f) == -1.f);
+    assert(codec_round_trip<byte_t>(1.f) == 1.f);
+    assert(codec_round_trip<byte_t>(5.f) == 1.f);
+    assert(codec_round_trip<byte_t>(std::nanf("")) == -1.f);
+    assert(std::abs(codec_round_trip<byte_t>(0.3f) - 0.3f) <= 1.f / 255);
+
+    // Steps that float cannot represent must not wrap Max around to Min
+    using wide_t = ecs_history::codec::quantized_t<0.f, 100.f, 25>;
+    assert(codec_round_trip<wide_t>(100.f) == 100.f);
+    assert(codec_round_trip<wide_t>(0.f) == 0.f);
+    using full_t = ecs_history::codec::quantized_t<-512.f, 512.f, 32>;
+    assert(codec_round_trip<full_t>(512.f) == 512.f);
+    assert(codec_round_trip<full_t>(-512.f) == -512.f);
+    assert(std::abs(codec_round_trip<full_t>(123.456f) - 123.456f) <= 1e-4f);
+}
+
+static void test_half_codec() {
+    using half_t = ecs_history::codec::half_t;
+    assert(codec_round_trip<half_t>(1.f) == 1.f);
+    assert(codec_round_trip<half_t>(-2.5f) == -2.5f);
+    assert(codec_round_trip<half_t>(65504.f) == 65504.f);
+    // Halfway cases round to even
+    assert(codec_round_trip<half_t>(1.f + std::ldexp(1.f, -11)) == 1.f);
+    assert(codec_round_trip<half_t>(1.f + 3 * std::ldexp(1.f, -11)) == 1.f + std::ldexp(1.f, -9));
+    // Subnormals
+    assert(codec_round_trip<half_t>(std::ldexp(1.f, -24)) == std::ldexp(1.f, -24));
+    assert(codec_round_trip<half_t>(std::ldexp(1.f, -25)) == 0.f);
+    assert(codec_round_trip<half_t>(3 * std::ldexp(1.f, -25)) == std::ldexp(1.f, -23));
+    assert(codec_round_trip<half_t>(std::ldexp(1.f, -30)) == 0.f);
+    // Overflow, infinity and NaN
+    assert(std::isinf(codec_round_trip<half_t>(1e6f)));
+    assert(codec_round_trip<half_t>(-INFINITY) == -INFINITY);
+    assert(std::isnan(codec_round_trip<half_t>(std::nanf(""))));
+}
+
+static void test_smallest_three_codec() {
+    using codec_t = ecs_history::codec::smallest_three_t<rotation_t>;
+    const auto close = [](const rotation_t &a, const rotation_t &b) {
+        return std::abs(a.x - b.x) < 0.01f && std::abs(a.y - b.y) < 0.01f &&
+               std::abs(a.z - b.z) < 0.01f && std::abs(a.w - b.w) < 0.01f;
+    };
+    const rotation_t identity{0.f, 0.f, 0.f, 1.f};
+    assert(close(codec_round_trip<codec_t>(identity), identity));
+    // q and -q are the same rotation, the largest component comes back positive
+    assert(close(codec_round_trip<codec_t>(rotation_t{0.f, 0.f, 0.f, -1.f}), identity));
+    const float norm = std::sqrt(30.f);
+    const rotation_t rotation{1.f / norm, -2.f / norm, 3.f / norm, -4.f / norm};
+    const rotation_t negated{-rotation.x, -rotation.y, -rotation.z, -rotation.w};
+    assert(close(codec_round_trip<codec_t>(rotation), negated));
+}
+
+/**
+ * No-op updates of components with drop_noop_updates_t are dropped when recorded and by
+ * commit_t::drop_noop_updates, those of other components are kept.
+ */
+static void test_drop_noop_updates() {
+    world_t sender;
+    auto &boxes = sender.monitor<bounding_box_t>();
+    auto &healths = sender.monitor<health_t>();
+    const auto entity = sender.entities.create();
+    boxes.emplace(entity, bounding_box_t{1});
+    healths.emplace(entity, health_t{100});
+    ecs_history::create_commit(sender.monitors, sender.entities);
+
+    boxes.patch(entity, [](bounding_box_t &box) { box.value = 1; });
+    healths.patch(entity, [](health_t &health) { health.value = 100; });
+    const auto recorded = ecs_history::create_commit(sender.monitors, sender.entities);
+    assert(recorded->change_sets[0]->count() == 1);
+    assert(recorded->change_sets[1]->count() == 0);
+
+    healths.patch(entity, [](health_t &health) { health.value = 90; });
+    const auto changed = ecs_history::create_commit(sender.monitors, sender.entities);
+    assert(changed->change_sets[1]->count() == 1);
+
+    const auto static_entity = sender.entities.get_static_entity(entity);
+    auto box_changes = std::make_unique<ecs_history::change_set_t<bounding_box_t> >();
+    box_changes->add_change(std::make_unique<ecs_history::update_change_t<bounding_box_t> >(
+        static_entity,
+        bounding_box_t{1},
+        bounding_box_t{1}));
+    auto health_changes = std::make_unique<ecs_history::change_set_t<health_t> >();
+    health_changes->add_change(std::make_unique<ecs_history::update_change_t<health_t> >(
+        static_entity,
+        health_t{90},
+        health_t{90}));
+    health_changes->add_change(std::make_unique<ecs_history::update_change_t<health_t> >(
+        static_entity,
+        health_t{90},
+        health_t{80}));
+    ecs_history::commit_t commit;
+    commit.change_sets.push_back(std::move(box_changes));
+    commit.change_sets.push_back(std::move(health_changes));
+    assert(commit.drop_noop_updates() == 1);
+    assert(commit.change_sets[0]->count() == 1);
+    assert(commit.change_sets[1]->count() == 1);
+    const auto &kept = static_cast<const ecs_history::change_set_t<health_t> &>(*commit.change_sets[1]);
+    assert(static_cast<const ecs_history::update_change_t<health_t> &>(kept.at(0)).new_value.get().value == 80);
+}
+
+/**
+ * Asserts that both worlds have the same T values for the same static entities.
+ */
+template<typename T>
+static void assert_same_values(world_t &expected, world_t &actual) {
+    const auto &expected_storage = expected.reg.storage<T>();
+    const auto &actual_storage = actual.reg.storage<T>();
+    assert(actual_storage.size() == expected_storage.size());
+    for (const auto [entity, value] : expected_storage.each()) {
+        const auto static_entity = expected.entities.get_static_entity(entity);
+        assert(actual_storage.get(actual.entities.get_entity(static_entity)).value == value.value);
+    }
+}
+/**
+ * Encodes a commit in session format and decodes it, as sending it over a connection does.
+ */
+static std::unique_ptr<ecs_history::commit_t> session_transmit(
+    ecs_history::serialization::session_encoder_t &encoder,
+    ecs_history::serialization::session_decoder_t &decoder,
+    const ecs_history::commit_t &commit,
+    const ecs_history::static_entities_t &static_entities) {
+    std::ostringstream out;
+    {
+        cereal::PortableBinaryOutputArchive archive(out);
+        encoder.encode_commit(archive, commit, &static_entities);
+    }
+    std::istringstream in(std::move(out).str());
+    cereal::PortableBinaryInputArchive archive(in);
+    return decoder.decode_commit(archive, component_registry());
+}
+
+/**
+ * Encoder and decoder stay in sync across releases, reused indices, despawns and a commit
+ * that is rolled back and sent again.
+ */
+static void test_session_sync() {
+    world_t sender;
+    auto &boxes = sender.monitor<bounding_box_t>();
+    world_t receiver;
+    receiver.monitor<bounding_box_t>();
+    ecs_history::serialization::session_encoder_t encoder;
+    ecs_history::serialization::session_decoder_t decoder;
+    const auto send = [&](const ecs_history::commit_t &commit) {
+        auto received = session_transmit(encoder, decoder, commit, sender.entities);
+        ecs_history::apply_commit(receiver.reg, receiver.monitors, *received);
+        return received;
+    };
+
+    const auto a = sender.entities.create();
+    const auto b = sender.entities.create();
+    boxes.emplace(a, bounding_box_t{1});
+    boxes.emplace(b, bounding_box_t{2});
+    send(*ecs_history::create_commit(sender.monitors, sender.entities));
+    assert(encoder.size() == 2 && decoder.size() == 2);
+
+    // a left the interest of the peer, its index is released with the next commit
+    encoder.release(sender.entities.get_static_entity(a));
+    boxes.patch(b, [](bounding_box_t &box) { box.value = 3; });
+    send(*ecs_history::create_commit(sender.monitors, sender.entities));
+    assert(encoder.size() == 1 && decoder.size() == 1);
+
+    // c gets the index of a
+    const auto c = sender.entities.create();
+    boxes.emplace(c, bounding_box_t{4});
+    const auto with_c = send(*ecs_history::create_commit(sender.monitors, sender.entities));
+    assert(with_c->change_sets[0]->entity_at(0) == sender.entities.get_static_entity(c));
+    assert(encoder.size() == 2 && decoder.size() == 2);
+
+    // Despawned entities are released after the commit that destroys them
+    const auto static_b = sender.entities.get_static_entity(b);
+    boxes.remove(b);
+    send(*ecs_history::create_commit(sender.monitors, sender.entities));
+    assert(!receiver.entities.has_entity(static_b));
+    assert(encoder.size() == 1 && decoder.size() == 2);
+
+    // d is created, rolled back and sent again
+    const auto d = sender.entities.create();
+    const auto static_d = sender.entities.get_static_entity(d);
+    boxes.emplace(d, bounding_box_t{5});
+    const auto created = ecs_history::create_commit(sender.monitors, sender.entities);
+    send(*created);
+    assert(encoder.size() == 2 && decoder.size() == 2);
+    const auto rolled_back = created->invert();
+    ecs_history::apply_commit(sender.reg, sender.monitors, *rolled_back);
+    send(*rolled_back);
+    assert(!sender.entities.has_entity(static_d) && !receiver.entities.has_entity(static_d));
+    assert(encoder.size() == 1);
+    ecs_history::apply_commit(sender.reg, sender.monitors, *created);
+    const auto resent = send(*created);
+    assert(resent->change_sets[0]->entity_at(0) == static_d);
+    assert(encoder.size() == 2 && decoder.size() == 2);
+
+    assert_same_values<bounding_box_t>(sender, receiver);
+}
+
+/**
+ * Stepping through a commit with small budgets ends in the same state as apply_commit.
+ */
+static void test_incremental_apply() {
+    world_t sender;
+    auto &boxes = sender.monitor<bounding_box_t>();
+    auto &healths = sender.monitor<health_t>();
+    world_t applied;
+    applied.monitor<bounding_box_t>();
+    applied.monitor<health_t>();
+    world_t stepped;
+    stepped.monitor<bounding_box_t>();
+    stepped.monitor<health_t>();
+
+    std::vector<entt::entity> entities;
+    for (uint8_t i = 0; i < 8; ++i) {
+        const auto entity = sender.entities.create();
+        boxes.emplace(entity, bounding_box_t{i});
+        healths.emplace(entity, health_t{100});
+        entities.push_back(entity);
+    }
+    const auto created = ecs_history::create_commit(sender.monitors, sender.entities);
+    ecs_history::apply_commit(applied.reg, applied.monitors, *transmit(*created));
+    ecs_history::apply_commit(stepped.reg, stepped.monitors, *transmit(*created));
+
+    const auto despawned = sender.entities.get_static_entity(entities[0]);
+    boxes.remove(entities[0]);
+    healths.remove(entities[0]);
+    healths.remove(entities[1]);
+    for (size_t i = 2; i < entities.size(); ++i) {
+        healths.patch(entities[i], [i](health_t &health) { health.value = static_cast<uint16_t>(i); });
+    }
+    const auto spawned = sender.entities.create();
+    boxes.emplace(spawned, bounding_box_t{42});
+    const auto commit = ecs_history::create_commit(sender.monitors, sender.entities);
+
+    ecs_history::apply_commit(applied.reg, applied.monitors, *transmit(*commit));
+    ecs_history::incremental_apply_t incremental(stepped.reg,
+                                                 stepped.monitors,
+                                                 std::shared_ptr<const ecs_history::commit_t>(transmit(*commit)));
+    size_t steps = 1;
+    while (!incremental.step(ecs_history::apply_budget_t::changes(steps % 2 + 1))) {
+        steps++;
+    }
+    assert(steps > 2);
+    assert(incremental.applied() == incremental.total());
+
+    assert_same_values<bounding_box_t>(applied, stepped);
+    assert_same_values<health_t>(applied, stepped);
+    assert(!stepped.entities.has_entity(despawned));
+    assert(stepped.entities.get_versions() == applied.entities.get_versions());
+    // Applied changes are not recorded, the monitors record again afterward
+    assert(ecs_history::create_commit(stepped.monitors, stepped.entities)->count() == 0);
+    const auto local = stepped.entities.get_entity(sender.entities.get_static_entity(entities[1]));
+    stepped.reg.storage<bounding_box_t>().patch(local, [](bounding_box_t &box) { box.value = 7; });
+    assert(ecs_history::create_commit(stepped.monitors, stepped.entities)->count() == 1);
+}
+
+/**
+ * Sender and receiver checksums agree after commits with lossy codecs and despawns,
+ * and diverging_storages finds the storage that diverged.
+ */
+static void test_checksums() {
+    world_t sender;
+    auto &boxes = sender.monitor<bounding_box_t>();
+    auto &positions = sender.monitor<position_t>();
+    sender.entities.set_checksum_tracking(true);
+    world_t receiver;
+    receiver.monitor<bounding_box_t>();
+    receiver.monitor<position_t>();
+    receiver.entities.set_checksum_tracking(true);
+    const auto send = [&] {
+        auto commit = transmit(*ecs_history::create_commit(sender.monitors, sender.entities));
+        assert(commit->checksum.has_value());
+        ecs_history::apply_commit(receiver.reg, receiver.monitors, *commit);
+        return commit;
+    };
+
+    std::vector<entt::entity> entities;
+    for (uint8_t i = 0; i < 4; ++i) {
+        const auto entity = sender.entities.create();
+        boxes.emplace(entity, bounding_box_t{i});
+        positions.emplace(entity, position_t{i * 1.37f, i * -2.71f});
+        entities.push_back(entity);
+    }
+    auto commit = send();
+    assert(ecs_history::checksum_matches(receiver.entities, *commit));
+    assert(receiver.entities.checksum() == sender.entities.checksum());
+
+    positions.patch(entities[1], [](position_t &position) { position.x = 33.3333f; });
+    boxes.patch(entities[2], [](bounding_box_t &box) { box.value = 9; });
+    const auto despawned = sender.entities.get_static_entity(entities[3]);
+    sender.reg.destroy(entities[3]);
+    commit = send();
+    assert(commit->destroyed_entities == std::vector{despawned});
+    assert(!receiver.entities.has_entity(despawned));
+    assert(ecs_history::checksum_matches(receiver.entities, *commit));
+    assert(ecs_history::diverging_storages(receiver.entities, *commit).empty());
+    assert(receiver.entities.get_storage_checksums() == sender.entities.get_storage_checksums());
+
+    // A local change the sender does not know about
+    const auto diverged = receiver.entities.get_entity(sender.entities.get_static_entity(entities[0]));
+    receiver.reg.storage<bounding_box_t>().patch(diverged, [](bounding_box_t &box) { box.value = 200; });
+    boxes.patch(entities[1], [](bounding_box_t &box) { box.value = 10; });
+    positions.patch(entities[2], [](position_t &position) { position.y = 0.5f; });
+    commit = send();
+    assert(!ecs_history::checksum_matches(receiver.entities, *commit));
+    assert(ecs_history::diverging_storages(receiver.entities, *commit) ==
+           std::vector{entt::type_hash<bounding_box_t>::value()});
+
+    // Padding does not take part in checksums
+    velocity_t zeroed;
+    velocity_t filled;
+    std::memset(&zeroed, 0, sizeof(velocity_t));
+    std::memset(&filled, 0xff, sizeof(velocity_t));
+    zeroed.axis = filled.axis = 1;
+    zeroed.speed = filled.speed = 2;
+    assert(ecs_history::value_checksum(zeroed) == ecs_history::value_checksum(filled));
+}
+
+/**
+ * A shared value is counted once, by the payload it was created in.
+ */
+static void test_shared_payload_usage() {
+    const ecs_history::payload_t<mesh_t> created(mesh_t{std::vector<uint8_t>(1024)});
+    const size_t bytes = created.heap_usage();
+    assert(bytes > 1024);
+    {
+        const ecs_history::payload_t<mesh_t> copy = created;
+        assert(&copy.get() == &created.get());
+        assert(copy.heap_usage() == 0);
+        assert(created.heap_usage() == bytes);
+    }
+    assert(created.heap_usage() == bytes);
+}
+
+/**
+ * Applying a run of commits in one pass and inverting them one by one ends in the same
+ * states as apply_commit, including entities constructed and destroyed within the run
+ * and runs that bring a destroyed entity back.
+ */
+static void test_apply_commits() {
+    world_t sender;
+    auto &boxes = sender.monitor<bounding_box_t>();
+    auto &healths = sender.monitor<health_t>();
+    world_t base;
+    world_t sequential;
+    world_t coalesced;
+    for (auto *world : {&base, &sequential, &coalesced}) {
+        world->monitor<bounding_box_t>();
+        world->monitor<health_t>();
+    }
+    const auto assert_same = [](world_t &expected, world_t &actual) {
+        assert_same_values<bounding_box_t>(expected, actual);
+        assert_same_values<health_t>(expected, actual);
+        assert(actual.entities.get_versions() == expected.entities.get_versions());
+    };
+    // Received by sequential, coalesced gets its own copies
+    std::vector<std::unique_ptr<ecs_history::commit_t> > received;
+    std::vector<std::unique_ptr<ecs_history::commit_t> > copies;
+    const auto send = [&](const ecs_history::commit_t &commit) {
+        received.push_back(transmit(commit));
+        copies.push_back(transmit(commit));
+    };
+    const auto apply_run = [&](const size_t begin) {
+        std::vector<const ecs_history::commit_t *> run;
+        for (size_t i = begin; i < received.size(); ++i) {
+            ecs_history::apply_commit(sequential.reg, sequential.monitors, *received[i]);
+            run.push_back(copies[i].get());
+        }
+        ecs_history::apply_commits(coalesced.reg, coalesced.monitors, run);
+        assert_same(sequential, coalesced);
+    };
+
+    const auto first = sender.entities.create();
+    const auto second = sender.entities.create();
+    boxes.emplace(first, bounding_box_t{1});
+    boxes.emplace(second, bounding_box_t{2});
+    const auto created = ecs_history::create_commit(sender.monitors, sender.entities);
+    for (auto *world : {&base, &sequential, &coalesced}) {
+        ecs_history::apply_commit(world->reg, world->monitors, *transmit(*created));
+    }
+
+    boxes.patch(first, [](bounding_box_t &box) { box.value = 3; });
+    const auto third = sender.entities.create();
+    boxes.emplace(third, bounding_box_t{4});
+    healths.emplace(third, health_t{100});
+    send(*ecs_history::create_commit(sender.monitors, sender.entities));
+    boxes.patch(first, [](bounding_box_t &box) { box.value = 5; });
+    healths.patch(third, [](health_t &health) { health.value = 90; });
+    boxes.remove(second);
+    send(*ecs_history::create_commit(sender.monitors, sender.entities));
+    // third is constructed and destroyed within the run
+    const auto static_third = sender.entities.get_static_entity(third);
+    sender.reg.destroy(third);
+    healths.emplace(first, health_t{50});
+    send(*ecs_history::create_commit(sender.monitors, sender.entities));
+
+    using commits_t = std::vector<const ecs_history::commit_t *>;
+    assert(ecs_history::can_apply_commits(coalesced.reg, commits_t{copies[0].get(), copies[1].get()}));
+    assert(!ecs_history::can_apply_commits(coalesced.reg, commits_t{copies[1].get(), copies[0].get()}));
+    apply_run(0);
+    assert(!coalesced.entities.has_entity(static_third));
+
+    // Every commit of the run can still be inverted on its own
+    for (size_t i = received.size(); i-- > 0;) {
+        ecs_history::apply_commit(sequential.reg, sequential.monitors, *received[i]->invert());
+        ecs_history::apply_commit(coalesced.reg, coalesced.monitors, *copies[i]->invert());
+        assert_same(sequential, coalesced);
+    }
+    assert_same_values<bounding_box_t>(base, coalesced);
+    assert_same_values<health_t>(base, coalesced);
+    for (size_t i = 0; i < received.size(); ++i) {
+        ecs_history::apply_commit(sequential.reg, sequential.monitors, *received[i]);
+        ecs_history::apply_commit(coalesced.reg, coalesced.monitors, *copies[i]);
+    }
+
+    // first is destroyed and brought back by undoing that, which is applied one by one
+    const auto static_first = sender.entities.get_static_entity(first);
+    const size_t begin = received.size();
+    sender.reg.destroy(first);
+    const auto destroyed = ecs_history::create_commit(sender.monitors, sender.entities);
+    send(*destroyed);
+    const auto restored = destroyed->invert();
+    ecs_history::apply_commit(sender.reg, sender.monitors, *restored);
+    send(*restored);
+    apply_run(begin);
+    const auto restored_first = coalesced.entities.get_entity(static_first);
+    assert(coalesced.reg.storage<bounding_box_t>().get(restored_first).value == 5);
+    assert(coalesced.reg.storage<health_t>().get(restored_first).value == 50);
+}
+
+/**
+ * The snapshot of a join plus the commits since reproduce the registry, whenever the service
+ * regenerated its snapshot.
+ */
+static void test_join_service() {
+    world_t sender;
+    auto &boxes = sender.monitor<bounding_box_t>();
+    auto &healths = sender.monitor<health_t>();
+    std::vector<entt::entity> entities;
+    for (uint8_t i = 0; i < 4; ++i) {
+        entities.push_back(sender.entities.create());
+        boxes.emplace(entities.back(), bounding_box_t{i});
+    }
+    ecs_history::create_commit(sender.monitors, sender.entities);
+
+    const auto joins = [&sender](const ecs_history::join_state_t &state) {
+        world_t joiner;
+        ecs_history::serialization::deserialize_snapshot(*state.snapshot, joiner.reg, component_registry());
+        for (const auto &shipped : state.commits) {
+            const auto commit = ecs_history::serialization::deserialize_encoded_commit(shipped.bytes,
+                component_registry());
+            ecs_history::apply_commit(joiner.reg, joiner.monitors, *commit);
+        }
+        assert_same_values<bounding_box_t>(sender, joiner);
+        assert_same_values<health_t>(sender, joiner);
+    };
+
+    ecs_history::commit_id_generator_t generator;
+    ecs_history::join_service_t service{sender.reg,
+                                        ecs_history::FIRST_BASE_ID,
+                                        component_registry(),
+                                        std::chrono::steady_clock::duration::zero()};
+    ecs_history::commit_pipeline_t pipeline{4};
+    ecs_history::commit_id last = ecs_history::FIRST_BASE_ID;
+    for (uint8_t i = 0; i < 4; ++i) {
+        boxes.patch(entities[i], [i](bounding_box_t &box) { box.value = static_cast<uint8_t>(10 + i); });
+        healths.emplace(entities[i], health_t{i});
+        if (i == 2) {
+            sender.reg.destroy(entities[1]);
+        }
+        last = generator.next();
+        pipeline.submit(last, ecs_history::create_commit(sender.monitors, sender.entities));
+        service.publish(*pipeline.wait());
+        joins(service.join());
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (service.join().snapshot_id != last) {
+        assert(std::chrono::steady_clock::now() < deadline);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    const auto state = service.join();
+    assert(state.commits.empty());
+    assert(service.snapshots() > 1);
+    joins(state);
+}
+
+/**
+ * Changes masked out by a component filter still move the entity versions of a subscriber on,
+ * so the next filtered commit applies to its history.
+ */
+static void test_filtered_history() {
+    world_t sender;
+    auto &boxes = sender.monitor<bounding_box_t>();
+    auto &healths = sender.monitor<health_t>();
+    world_t subscriber;
+    subscriber.monitor<bounding_box_t>();
+    subscriber.monitor<health_t>();
+    ecs_history::history_t history{subscriber.reg, subscriber.monitors};
+    ecs_history::commit_id_generator_t generator;
+
+    using filter_t = ecs_history::serialization::interest_filter_t;
+    const auto only_boxes = std::make_shared<const filter_t>(
+        filter_t{{entt::type_hash<bounding_box_t>::value()}, std::nullopt, {}});
+    auto base = ecs_history::FIRST_BASE_ID;
+    const auto send = [&] {
+        const auto commit = ecs_history::create_commit(sender.monitors, sender.entities);
+        const auto buffers = ecs_history::serialization::serialize_filtered_commit(*commit, {only_boxes});
+        auto received = receive(*buffers[0]);
+        assert(ecs_history::can_apply_commit(subscriber.reg, *received));
+        const auto id = generator.next();
+        history.apply_commit(base, id, received);
+        base = id;
+    };
+
+    const auto entity = sender.entities.create();
+    const auto static_entity = sender.entities.get_static_entity(entity);
+    boxes.emplace(entity, bounding_box_t{1});
+    healths.emplace(entity, health_t{100});
+    send();
+    // Only masked out changes
+    healths.patch(entity, [](health_t &health) { health.value = 90; });
+    send();
+    boxes.patch(entity, [](bounding_box_t &box) { box.value = 2; });
+    healths.patch(entity, [](health_t &health) { health.value = 80; });
+    send();
+
+    assert(history.commits.size() == 3);
+    const auto received = subscriber.entities.get_entity(static_entity);
+    assert(subscriber.reg.storage<bounding_box_t>().get(received).value == 2);
+    assert(subscriber.reg.storage<health_t>().empty());
+    assert(subscriber.entities.get_version(static_entity) == sender.entities.get_version(static_entity));
+}
+
+int main() {
+    spdlog::set_level(spdlog::level::info);
+
+    test_sequential_commits();
+    test_created_entity_versions();
+    test_concurrent_readd_last_component();
+    test_concurrent_worker_order();
+    test_concurrent_monitors_share_entity();
+    test_commit_pipeline();
+    test_filtered_commit();
+    test_filtered_history();
+    test_encoding_cache();
+    test_snapshot_round_trip();
+    test_epoch_tracking();
+    test_value_at();
+    test_quantized_codec();
+    test_half_codec();
+    test_smallest_three_codec();
+    test_drop_noop_updates();
+    test_session_sync();
+    test_incremental_apply();
+    test_checksums();
+    test_shared_payload_usage();
+    test_apply_commits();
+    test_join_service();
 
     return 0;
-}
\ No newline at end of file
+}
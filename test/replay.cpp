@@ -0,0 +1,316 @@
+//
+// Created by felix on 10/19/26.
+//
+
+#include "ecs_history/serialization/serialization.hpp"
+#include "ecs_history/history.hpp"
+#include "ecs_history/component/default_component.hpp"
+#include "ecs_history/entt/change_mixin.hpp"
+#include "ecs_history/workload_recorder.hpp"
+
+#include <cereal/types/string.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+
+using std::chrono::steady_clock;
+
+constexpr size_t MAX_COMPONENT_TYPES = 32;
+
+/**
+ * Sizes of the stand-ins, a recorded type is replayed by the smallest one it fits.
+ * 0 stands for types recorded as serialized values or larger than all others.
+ */
+constexpr std::array<size_t, 10> STAND_IN_SIZES{0, 4, 8, 16, 32, 64, 128, 256, 512, 1024};
+
+/**
+ * Stands in for the recorded component with the same index. Holds the recorded value bytes
+ * inline, like payload_t in benchmark.cpp, so changes, their count and their size match the trace.
+ */
+template<size_t Size, size_t Index>
+struct replay_component_t {
+    std::array<uint8_t, Size> bytes{};
+
+    void assign(const std::string &value) {
+        std::memcpy(this->bytes.data(), value.data(), std::min(value.size(), Size));
+    }
+};
+
+/**
+ * Stands in for a component recorded as serialized value, whose size in memory is unknown.
+ */
+template<size_t Index>
+struct replay_component_t<0, Index> {
+    std::string bytes;
+
+    void assign(const std::string &value) {
+        this->bytes = value;
+    }
+};
+
+template<size_t Size, size_t Index>
+struct entt::storage_type<replay_component_t<Size, Index> > {
+    /*! @brief Type-to-storage conversion result. */
+    using type = change_storage_t<replay_component_t<Size, Index> >;
+};
+
+template<typename Archive, size_t Size, size_t Index>
+void serialize(Archive &archive, replay_component_t<Size, Index> &component) {
+    if constexpr (Size == 0) {
+        archive(component.bytes);
+    } else {
+        archive(cereal::binary_data(component.bytes.data(), Size));
+    }
+}
+
+static size_t stand_in_size(const ecs_history::workload_type_t &type) {
+    if (!type.serialized) {
+        for (const auto size : STAND_IN_SIZES) {
+            if (size >= type.size) {
+                return size;
+            }
+        }
+    }
+    return 0;
+}
+
+template<typename Indices>
+class replay_t;
+
+/**
+ * Drives the recorded events through monitors, create_commit, serialization and a receiving
+ * history, timing every stage with metrics_t.
+ */
+template<size_t... Is>
+class replay_t<std::index_sequence<Is...> > {
+    ecs_history::metrics_t<> metrics;
+
+    entt::registry reg;
+    ecs_history::static_entities_t &entities = reg.ctx().emplace<ecs_history::static_entities_t>();
+    std::vector<std::unique_ptr<ecs_history::base_storage_monitor_t> > monitors;
+    // Recorded entity -> replayed entity and its number of components
+    std::unordered_map<uint32_t, std::pair<entt::entity, uint32_t> > replayed;
+    // Stand-in size of every recorded type
+    std::vector<size_t> sizes;
+
+    entt::registry reg2;
+    ecs_history::static_entities_t &entities2 = reg2.ctx().emplace<
+        ecs_history::static_entities_t>();
+    std::vector<std::unique_ptr<ecs_history::base_storage_monitor_t> > monitors2;
+    ecs_history::basic_history_t<ecs_history::metrics_t<> > history2{reg2, monitors2, metrics};
+
+    ecs_history::registry::component_registry_t component_registry;
+    ecs_history::commit_id_generator_t id_generator;
+    ecs_history::commit_id last_id = ecs_history::FIRST_BASE_ID;
+    steady_clock::duration event_time{};
+    size_t event_count = 0;
+
+    template<size_t Index, typename Func>
+    static bool with_size(const size_t size, Func &func) {
+        return [&]<size_t... Ss>(std::index_sequence<Ss...>) {
+            return ((size == STAND_IN_SIZES[Ss] &&
+                     (func.template operator()<replay_component_t<STAND_IN_SIZES[Ss], Index> >(), true)) || ...);
+        }(std::make_index_sequence<STAND_IN_SIZES.size()>{});
+    }
+
+    template<typename Func>
+    bool with_type(const size_t type, Func &&func) {
+        const size_t size = this->sizes.at(type);
+        return ((type == Is && with_size<Is>(size, func)) || ...);
+    }
+
+    entt::entity acquire(const uint32_t recorded) {
+        const auto it = this->replayed.find(recorded);
+        if (it != this->replayed.end()) {
+            it->second.second++;
+            return it->second.first;
+        }
+        const auto entity = this->entities.create();
+        this->replayed.emplace(recorded, std::make_pair(entity, 1));
+        return entity;
+    }
+
+    entt::entity release(const uint32_t recorded) {
+        const auto it = this->replayed.find(recorded);
+        if (it == this->replayed.end()) {
+            throw std::runtime_error("trace destroys a component that was never constructed");
+        }
+        const auto entity = it->second.first;
+        if (--it->second.second == 0) {
+            this->replayed.erase(it);
+        }
+        return entity;
+    }
+
+    void commit() {
+        auto commit = ecs_history::create_commit(this->monitors, this->entities, this->metrics);
+
+        std::string bytes;
+        {
+            std::ostringstream oss;
+            {
+                cereal::PortableBinaryOutputArchive archive(oss);
+                ecs_history::serialization::serialize_commit(archive, *commit, this->metrics);
+            }
+            bytes = std::move(oss).str();
+        }
+
+        std::unique_ptr<ecs_history::commit_t> received;
+        {
+            [[maybe_unused]] const auto timer = this->metrics.time(ecs_history::stage_t::DESERIALIZE);
+            std::istringstream iss(bytes);
+            cereal::PortableBinaryInputArchive archive(iss);
+            received = ecs_history::serialization::deserialize_commit(archive, this->component_registry);
+        }
+        this->metrics.record_deserialized();
+
+        const auto id = this->id_generator.next();
+        this->history2.apply_commit(this->last_id, id, received);
+        this->last_id = id;
+    }
+
+public:
+    explicit replay_t(const std::vector<ecs_history::workload_type_t> &types) {
+        for (const auto &type : types) {
+            this->sizes.push_back(stand_in_size(type));
+        }
+        for (size_t type = 0; type < types.size(); ++type) {
+            this->with_type(type,
+                            [this]<typename T>() {
+                                this->monitors.push_back(std::make_unique<
+                                    ecs_history::storage_monitor_t<T, ecs_history::metrics_t<> > >(
+                                    this->entities,
+                                    this->reg.template storage<T>(),
+                                    this->metrics));
+                                std::unique_ptr<ecs_history::registry::component_t> component =
+                                    std::make_unique<ecs_history::default_component_t<T> >();
+                                this->component_registry.template register_component<T>(component);
+                            });
+        }
+    }
+
+    void run(const std::vector<ecs_history::workload_event_t> &events) {
+        auto start = steady_clock::now();
+        for (const auto &event : events) {
+            switch (event.type) {
+                case ecs_history::workload_event_type_t::CONSTRUCT: {
+                    const auto entity = this->acquire(event.entity);
+                    this->with_type(event.component,
+                                    [&]<typename T>() {
+                                        T component;
+                                        component.assign(event.value);
+                                        this->reg.template storage<T>().emplace(entity, std::move(component));
+                                    });
+                    break;
+                }
+                case ecs_history::workload_event_type_t::UPDATE: {
+                    const auto entity = this->replayed.at(event.entity).first;
+                    this->with_type(event.component,
+                                    [&]<typename T>() {
+                                        this->reg.template storage<T>().patch(entity,
+                                            [&event](T &component) {
+                                                component.assign(event.value);
+                                            });
+                                    });
+                    break;
+                }
+                case ecs_history::workload_event_type_t::DESTRUCT: {
+                    const auto entity = this->release(event.entity);
+                    this->with_type(event.component,
+                                    [&]<typename T>() {
+                                        this->reg.template storage<T>().remove(entity);
+                                    });
+                    break;
+                }
+                case ecs_history::workload_event_type_t::COMMIT:
+                    this->event_time += steady_clock::now() - start;
+                    this->commit();
+                    start = steady_clock::now();
+                    continue;
+                default:
+                    break;
+            }
+            this->event_count++;
+        }
+        this->event_time += steady_clock::now() - start;
+    }
+
+    void report(std::ostream &os, const size_t run) const {
+        const auto snapshot = this->metrics.snapshot();
+        const auto us = [](const double ns) {
+            return ns / 1000.0;
+        };
+        os << run << ",events," << this->event_count << ','
+            << (this->event_count == 0
+                    ? 0.0
+                    : us(std::chrono::duration<double, std::nano>(this->event_time).count() /
+                         static_cast<double>(this->event_count)))
+            << ",,,\n";
+        const std::pair<const char *, ecs_history::stage_t> stages[] = {
+            {"create commit", ecs_history::stage_t::CREATE_COMMIT},
+            {"serialize", ecs_history::stage_t::SERIALIZE},
+            {"deserialize", ecs_history::stage_t::DESERIALIZE},
+            {"apply", ecs_history::stage_t::APPLY},
+        };
+        for (const auto &[name, stage] : stages) {
+            const auto &latency = snapshot.latency(stage);
+            os << run << ',' << name << ',' << latency.count << ',' << us(latency.mean_ns()) << ','
+                << us(static_cast<double>(latency.percentile_ns(0.5))) << ','
+                << us(static_cast<double>(latency.percentile_ns(0.99))) << ','
+                << us(static_cast<double>(latency.max_ns)) << '\n';
+        }
+        std::cerr << "run " << run << ": " << snapshot.commits << " commits, "
+            << snapshot.commit_changes << " changes, " << snapshot.serialized_bytes
+            << " serialized bytes\n";
+    }
+};
+
+int main(const int argc, char **argv) {
+    spdlog::set_level(spdlog::level::warn);
+
+    if (argc < 2) {
+        std::cerr << "usage: replay_workload <trace> [--repeat n]\n";
+        return 1;
+    }
+    size_t repeat = 1;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        const std::string arg = argv[i];
+        if (arg == "--repeat") {
+            repeat = std::stoul(argv[i + 1]);
+        } else {
+            std::cerr << "unknown argument " << arg << '\n';
+            return 1;
+        }
+    }
+
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file) {
+        std::cerr << "cannot open " << argv[1] << '\n';
+        return 1;
+    }
+    // The whole trace is read up front, so reading it is not part of the timings
+    ecs_history::workload_reader_t reader(file);
+    std::vector<ecs_history::workload_event_t> events;
+    while (auto event = reader.next()) {
+        events.push_back(std::move(*event));
+    }
+    if (reader.types().size() > MAX_COMPONENT_TYPES) {
+        std::cerr << "trace has " << reader.types().size() << " component types, at most "
+            << MAX_COMPONENT_TYPES << " are supported\n";
+        return 1;
+    }
+
+    std::cout << "run,stage,count,mean_us,p50_us,p99_us,max_us\n";
+    for (size_t run = 0; run < repeat; ++run) {
+        replay_t<std::make_index_sequence<MAX_COMPONENT_TYPES> > replay{reader.types()};
+        replay.run(events);
+        replay.report(std::cout, run);
+    }
+    return 0;
+}